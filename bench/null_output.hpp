@@ -0,0 +1,262 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_BENCH_NULL_OUTPUT_HPP
+#define MELOSIC_BENCH_NULL_OUTPUT_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+namespace chrono = std::chrono;
+
+#include <asio/buffer.hpp>
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <melosic/asio/audio_impl.hpp>
+#include <melosic/asio/audio_io.hpp>
+#include <melosic/asio/audio_service.hpp>
+#include <melosic/common/histogram.hpp>
+#include <melosic/melin/output.hpp>
+
+namespace Melosic {
+namespace Bench {
+
+/// Shared by the benchmark and every null output it creates, as outputs are constructed by the player.
+struct null_output_metrics {
+    /// pace writes as a device would rather than completing them immediately
+    std::atomic<bool> realtime{false};
+
+    /// microseconds from one write completing to the player submitting the next
+    histogram turnaround;
+
+    std::atomic<uint64_t> bytes{0};
+    /// audio written, in nanoseconds
+    std::atomic<uint64_t> audio_ns{0};
+    std::atomic<int64_t> first_write_ns{0};
+    std::atomic<int64_t> last_write_ns{0};
+
+    void reset() noexcept {
+        turnaround.reset();
+        bytes = 0;
+        audio_ns = 0;
+        first_write_ns = 0;
+        last_write_ns = 0;
+    }
+
+    /// Wall time from the first write to the last.
+    chrono::nanoseconds elapsed() const noexcept {
+        return chrono::nanoseconds(last_write_ns.load() - first_write_ns.load());
+    }
+};
+
+inline null_output_metrics& metrics() {
+    static null_output_metrics m;
+    return m;
+}
+
+/// An output device that throws its audio away.
+///
+/// Unpaced, every write completes as soon as the io_service gets to it, so the player runs as fast as it can decode.
+/// Paced, writes complete as a device buffering the latency target would, and running dry counts as an xrun.
+struct null_output_service_impl : AudioIO::AudioOutputServiceBase,
+                                  std::enable_shared_from_this<null_output_service_impl> {
+    using base_t = AudioIO::AudioOutputServiceBase;
+    using clock = chrono::steady_clock;
+
+    explicit null_output_service_impl(asio::io_service& service) : base_t(service), m_timer(service) {
+    }
+
+    void destroy() override {
+        std::error_code ec;
+        cancel(ec);
+    }
+
+    void cancel(std::error_code& ec) override {
+        m_timer.cancel();
+        ec.clear();
+    }
+
+    void assign(Output::device_descriptor, std::error_code& ec) override {
+        ec.clear();
+    }
+
+    AudioSpecs prepare(const AudioSpecs as, std::error_code& ec) override {
+        m_specs = as;
+        m_state = Output::DeviceState::Ready;
+        ec.clear();
+        return m_specs;
+    }
+
+    void play(std::error_code& ec) override {
+        m_state = Output::DeviceState::Playing;
+        m_written = 0;
+        m_epoch = clock::now();
+        m_completed = {};
+        ec.clear();
+    }
+
+    void pause(std::error_code& ec) override {
+        m_state = Output::DeviceState::Paused;
+        ec.clear();
+    }
+
+    void unpause(std::error_code& ec) override {
+        // carry on from where the device clock would have stopped
+        m_epoch = clock::now() - written_time();
+        m_state = Output::DeviceState::Playing;
+        ec.clear();
+    }
+
+    void stop(std::error_code& ec) override {
+        m_timer.cancel();
+        m_state = Output::DeviceState::Stopped;
+        ec.clear();
+    }
+
+    size_t write_some(const asio::const_buffer& buf, std::error_code& ec) override {
+        const auto deadline = account(asio::buffer_size(buf));
+        if(metrics().realtime)
+            std::this_thread::sleep_until(deadline);
+        ec.clear();
+        return asio::buffer_size(buf);
+    }
+
+    size_t write_some(const AudioIO::const_buffers& bufs, std::error_code& ec) override {
+        return write_some(asio::const_buffer(nullptr, total_size(bufs)), ec);
+    }
+
+    void async_prepare(const AudioSpecs as, PrepareHandler handler) override {
+        asio::post(get_io_service(), [ self = shared_from_this(), as, handler = std::move(handler) ] {
+            std::error_code ec;
+            const auto out_as = self->prepare(as, ec);
+            handler(ec, out_as);
+        });
+    }
+
+    void async_write_some(const asio::const_buffer& buf, WriteHandler handler) override {
+        const auto n = asio::buffer_size(buf);
+        const auto deadline = account(n);
+        auto complete = [ self = shared_from_this(), n, handler = std::move(handler) ](std::error_code ec) {
+            if(ec) {
+                handler(std::make_error_code(std::errc::operation_canceled), 0);
+                return;
+            }
+            self->m_completed = clock::now();
+            handler({}, n);
+        };
+        if(!metrics().realtime) {
+            asio::post(get_io_service(), [complete = std::move(complete)] { complete({}); });
+            return;
+        }
+        m_timer.expires_at(deadline);
+        m_timer.async_wait(std::move(complete));
+    }
+
+    void async_write_some(const AudioIO::const_buffers& bufs, WriteHandler handler) override {
+        // only sizes matter here
+        async_write_some(asio::const_buffer(nullptr, total_size(bufs)), std::move(handler));
+    }
+
+    void latency(chrono::microseconds target) override {
+        m_latency = target;
+    }
+
+    AudioIO::output_buffering buffering() const override {
+        const auto frames = m_specs.time_to_samples(m_latency);
+        return {frames, frames};
+    }
+
+    size_t delay(std::error_code& ec) override {
+        ec.clear();
+        if(!metrics().realtime || m_state != Output::DeviceState::Playing)
+            return 0;
+        const auto queued = m_epoch + written_time() - clock::now();
+        return queued > clock::duration::zero() ? m_specs.time_to_samples(queued) : 0;
+    }
+
+    AudioSpecs current_specs() const override {
+        return m_specs;
+    }
+
+    Output::DeviceState state() const override {
+        return m_state;
+    }
+
+    AudioIO::output_stats stats() const override {
+        return {m_xruns.load(std::memory_order_relaxed), m_xruns.load(std::memory_order_relaxed)};
+    }
+
+    bool non_blocking() const override {
+        return true;
+    }
+
+    void non_blocking(bool, std::error_code& ec) override {
+        ec.clear();
+    }
+
+  private:
+    static size_t total_size(const AudioIO::const_buffers& bufs) {
+        size_t n = 0;
+        for(auto&& buf : bufs)
+            n += asio::buffer_size(buf);
+        return n;
+    }
+
+    clock::duration written_time() const {
+        return m_specs.bytes_to_time<clock::duration>(m_written);
+    }
+
+    /// Records a write of n bytes, returning when a paced device would have room for it.
+    clock::time_point account(size_t n) {
+        auto&& m = metrics();
+        const auto now = clock::now();
+        const auto now_ns = chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+        int64_t zero = 0;
+        m.first_write_ns.compare_exchange_strong(zero, now_ns);
+        m.last_write_ns = now_ns;
+        if(m_completed != clock::time_point{})
+            m.turnaround.record(chrono::duration_cast<chrono::microseconds>(now - m_completed).count());
+        m.bytes += n;
+        m.audio_ns += m_specs.bytes_to_time<chrono::nanoseconds>(n).count();
+
+        if(m.realtime && now > m_epoch + written_time()) {
+            // the device has played everything it was given
+            m_xruns.fetch_add(1, std::memory_order_relaxed);
+            m_epoch = now - written_time();
+        }
+        m_written += n;
+        return m_epoch + written_time() - m_latency;
+    }
+
+    asio::steady_timer m_timer;
+    AudioSpecs m_specs;
+    Output::DeviceState m_state = Output::DeviceState::Initial;
+    uint64_t m_written = 0;
+    chrono::microseconds m_latency{chrono::milliseconds(200)};
+    clock::time_point m_epoch;
+    clock::time_point m_completed;
+    std::atomic<uint64_t> m_xruns{0};
+};
+
+using null_output = AudioIO::BasicAudioOutput<AudioIO::AudioOutputService<null_output_service_impl>>;
+
+} // namespace Bench
+} // namespace Melosic
+
+#endif // MELOSIC_BENCH_NULL_OUTPUT_HPP
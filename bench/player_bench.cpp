@@ -0,0 +1,266 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+namespace fs = boost::filesystem;
+
+#include <melosic/melin/kernel.hpp>
+#include <melosic/melin/config.hpp>
+#include <melosic/melin/decoder.hpp>
+#include <melosic/melin/logging.hpp>
+#include <melosic/melin/output.hpp>
+#include <melosic/melin/playlist.hpp>
+#include <melosic/melin/plugin.hpp>
+#include <melosic/core/player.hpp>
+#include <melosic/core/playlist.hpp>
+#include <melosic/core/track.hpp>
+#include <melosic/common/optional.hpp>
+#include <melosic/common/signal.hpp>
+
+#include "null_output.hpp"
+
+using namespace Melosic;
+using namespace std::literals;
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_allocated_bytes{0};
+
+} // namespace
+
+// count every allocation in the process, including those made by the library and plugins
+void* operator new(std::size_t n) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(n, std::memory_order_relaxed);
+    if(auto ptr = std::malloc(n ? n : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) {
+    return ::operator new(n);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+struct options {
+    bool realtime = false;
+    bool verbose = false;
+    int repeat = 20;
+    optional<int64_t> latency;
+    std::vector<fs::path> files;
+};
+
+void usage(const char* name) {
+    std::cerr << "usage: " << name << " [--realtime] [--latency MS] [--repeat N] [--verbose] [file...]\n"
+              << "Plays the files, or the lossless test files, through a null output and reports pipeline timings.\n";
+}
+
+optional<options> parse_options(int argc, char* argv[]) {
+    options opts;
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg{argv[i]};
+        if(arg == "--realtime")
+            opts.realtime = true;
+        else if(arg == "--verbose")
+            opts.verbose = true;
+        else if(arg == "--latency" && i + 1 < argc)
+            opts.latency = std::atoll(argv[++i]);
+        else if(arg == "--repeat" && i + 1 < argc)
+            opts.repeat = std::max(1, std::atoi(argv[++i]));
+        else if(arg.compare(0, 2, "--") == 0)
+            return nullopt;
+        else
+            opts.files.emplace_back(arg);
+    }
+    if(opts.files.empty()) {
+        for(const fs::path& file : boost::make_iterator_range(fs::directory_iterator(MELOSIC_BENCH_DATA_DIR), {}))
+            if(file.filename().string().compare(0, 9, "lossless_") == 0 && file.extension() != ".pcm")
+                opts.files.push_back(file);
+        std::sort(opts.files.begin(), opts.files.end());
+    }
+    return opts;
+}
+
+void print_summary(const char* name, const histogram::summary& s, const char* unit) {
+    std::cout << std::left << std::setw(22) << name << std::right << std::setw(10) << s.count << std::setw(12)
+              << std::fixed << std::setprecision(1) << s.mean() << std::setw(10) << s.percentile(0.5)
+              << std::setw(10) << s.percentile(0.9) << std::setw(10) << s.percentile(0.99) << std::setw(12) << s.max
+              << "  " << unit << "\n";
+}
+
+int run(const options& opts) {
+    Core::Kernel kernel;
+    Core::Player player(kernel);
+
+    kernel.getOutputManager()->addOutputDevice(
+        [](asio::io_service& io_service, Output::device_descriptor dev) -> std::unique_ptr<AudioIO::AudioOutputBase> {
+            return std::make_unique<Bench::null_output>(io_service, std::move(dev));
+        },
+        Output::device_descriptor{"null", "Discards audio"});
+
+    auto confman = kernel.getConfigManager();
+    confman->loadConfig();
+    confman->getConfigRoot()->getChild("Plugins")->putNode("search paths",
+                                                          std::vector<std::string>{MELOSIC_BENCH_PLUGIN_DIR});
+    confman->getConfigRoot()->getChild("Output")->putNode("output device", "null"s);
+    if(opts.latency)
+        confman->getConfigRoot()->getChild("Output")->putNode("latency", *opts.latency);
+    kernel.getPluginManager()->loadPlugins(kernel);
+
+    auto playlistman = kernel.getPlaylistManager();
+    auto playlist = playlistman->insert(0, "bench"s);
+    assert(playlist);
+    auto decman = kernel.getDecoderManager();
+    for(int i = 0; i < opts.repeat; ++i)
+        for(auto&& file : opts.files)
+            for(auto&& track : decman->tracks(file))
+                playlist->push_back(track);
+    if(playlist->empty()) {
+        std::cerr << "nothing to play\n";
+        return 1;
+    }
+    playlistman->setCurrent(0);
+
+    std::mutex mu;
+    std::condition_variable cv;
+    bool started = false, finished = false;
+    Output::DeviceState last_state = Output::DeviceState::Initial;
+    Signals::ScopedConnection conn{player.stateChangedSignal().connect([&](Output::DeviceState state) {
+        std::lock_guard<std::mutex> l(mu);
+        last_state = state;
+        if(state == Output::DeviceState::Playing)
+            started = true;
+        else if(started && (state == Output::DeviceState::Stopped || state == Output::DeviceState::Error))
+            finished = true;
+        cv.notify_all();
+    })};
+
+    auto&& metrics = Bench::metrics();
+    metrics.reset();
+    metrics.realtime = opts.realtime;
+    player.resetStats();
+
+    const auto allocations = g_allocations.load(), allocated_bytes = g_allocated_bytes.load();
+    const auto start = chrono::steady_clock::now();
+    player.play();
+    {
+        std::unique_lock<std::mutex> l(mu);
+        cv.wait(l, [&] { return finished || last_state == Output::DeviceState::Error; });
+    }
+    const auto wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const auto n_allocations = g_allocations.load() - allocations;
+    const auto n_allocated_bytes = g_allocated_bytes.load() - allocated_bytes;
+
+    if(last_state == Output::DeviceState::Error) {
+        std::cerr << "playback failed; rerun with --verbose for details\n";
+        return 1;
+    }
+
+    const auto audio = chrono::duration<double>(chrono::nanoseconds(metrics.audio_ns.load())).count();
+    // the player lets the device play out its buffer before stopping; don't count that
+    const auto writing = chrono::duration<double>(metrics.elapsed()).count();
+    const auto stats = player.stats();
+
+    std::cout << playlist->size() << " tracks, " << (opts.realtime ? "real-time" : "unpaced") << "\n"
+              << std::fixed << std::setprecision(3) << "audio:       " << audio << " s\n"
+              << "wall:        " << wall << " s (" << writing << " s writing)\n"
+              << "throughput:  " << std::setprecision(1) << (writing > 0 ? audio / writing : 0.0)
+              << " audio seconds per second\n"
+              << "allocations: " << n_allocations << " (" << n_allocated_bytes << " bytes), "
+              << (wall > 0 ? n_allocations / wall : 0.0) << " per second\n"
+              << "wakeups:     " << (wall > 0 ? stats.decode_wakeups / wall : 0.0) << " decode, "
+              << (wall > 0 ? stats.output_wakeups / wall : 0.0) << " output per second\n"
+              << "underruns:   " << stats.decoder_underruns << " decoder, " << stats.device_xruns << " device\n\n";
+
+    std::cout << std::left << std::setw(22) << "" << std::right << std::setw(10) << "count" << std::setw(12) << "mean"
+              << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(12) << "max"
+              << "\n";
+    print_summary("write turnaround", metrics.turnaround.read(), "us");
+    print_summary("write size", stats.write_size, "bytes");
+    print_summary("decode", stats.decode_time, "us");
+    print_summary("lock wait", stats.lock_wait, "us");
+    print_summary("buffer fill", stats.buffer_fill, "%");
+    print_summary("track change", stats.track_change, "us");
+    print_summary("decode interval", stats.decode_interval, "us");
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const auto opts = parse_options(argc, argv);
+    if(!opts) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // keep the user's configuration and library out of it
+    const auto home = fs::temp_directory_path() / fs::unique_path("melosic-bench-%%%%-%%%%");
+    fs::create_directories(home);
+    ::setenv("XDG_CONFIG_HOME", (home / "config").c_str(), 1);
+    ::setenv("XDG_DATA_HOME", (home / "data").c_str(), 1);
+
+    if(opts->verbose)
+        Logger::init();
+    else
+        logging::core::get()->set_logging_enabled(false);
+
+    int ret = 1;
+    try {
+        ret = run(*opts);
+    } catch(...) {
+        std::cerr << boost::current_exception_diagnostic_information() << std::endl;
+    }
+
+    boost::system::error_code ec;
+    fs::remove_all(home, ec);
+    return ret;
+}
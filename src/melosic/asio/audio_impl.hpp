@@ -18,18 +18,41 @@
 #ifndef MELOSIC_AUDIO_IMPL_HPP
 #define MELOSIC_AUDIO_IMPL_HPP
 
+#include <chrono>
 #include <memory>
 #include <system_error>
+namespace chrono = std::chrono;
 
 #include <asio/buffer.hpp>
 #include <asio/strand.hpp>
 
+#include <boost/container/static_vector.hpp>
+
 #include <melosic/common/audiospecs.hpp>
 #include <melosic/melin/output.hpp>
 
 namespace Melosic {
 namespace AudioIO {
 
+/// Device level events since the output was constructed.
+struct output_stats {
+    /// underruns, where the device ran out of audio to play
+    uint64_t xruns = 0;
+    /// errors, including xruns, successfully recovered from
+    uint64_t recoveries = 0;
+};
+
+/// The device's buffering as settled on by prepare(), in frames.
+struct output_buffering {
+    /// frames written between wakeups
+    size_t period_frames = 0;
+    /// frames the device holds, ie. the latency of a write
+    size_t buffer_frames = 0;
+};
+
+/// Buffers for one gathered write. Longer sequences are written a few buffers at a time.
+using const_buffers = boost::container::static_vector<asio::const_buffer, 4>;
+
 struct MELOSIC_EXPORT AudioOutputServiceBase {
     explicit AudioOutputServiceBase(asio::io_service& service) : m_service(service) {
     }
@@ -48,18 +71,59 @@ struct MELOSIC_EXPORT AudioOutputServiceBase {
     virtual void stop(std::error_code&) = 0;
     virtual size_t write_some(const asio::const_buffer&, std::error_code&) = 0;
 
+    /// Writes the buffers in order until the device is full, so several ring segments fill it in one go.
+    virtual size_t write_some(const const_buffers& bufs, std::error_code& ec) {
+        size_t n = 0;
+        for(auto&& buf : bufs) {
+            const auto r = write_some(buf, ec);
+            n += r;
+            if(ec || r < asio::buffer_size(buf))
+                break;
+        }
+        // what the device already took is reported; any error will recur on the next write
+        if(n > 0)
+            ec.clear();
+        return n;
+    }
+
     typedef std::function<void(std::error_code, AudioSpecs)> PrepareHandler;
+    /// As prepare(), without blocking the caller or the io_service; the handler gets the specs settled on, and is
+    /// run by the io_service. The output mustn't otherwise be used until then.
     virtual void async_prepare(AudioSpecs, PrepareHandler) = 0;
 
     typedef std::function<void(std::error_code, std::size_t)> WriteHandler;
     virtual void async_write_some(const asio::const_buffer&, WriteHandler) = 0;
 
+    /// Should write all the buffers on one wakeup. By default only the first is written.
+    virtual void async_write_some(const const_buffers& bufs, WriteHandler handler) {
+        async_write_some(bufs.empty() ? asio::const_buffer{} : bufs.front(), std::move(handler));
+    }
+
     virtual bool non_blocking() const = 0;
     virtual void non_blocking(bool, std::error_code&) = 0;
 
     virtual Output::DeviceState state() const = 0;
     virtual AudioSpecs current_specs() const = 0;
 
+    /// Target time from writing a sample to hearing it, applied by the next prepare().
+    /// Low latency makes pause and seek respond quickly at the cost of more frequent wakeups.
+    virtual void latency(chrono::microseconds) {
+    }
+    virtual output_buffering buffering() const {
+        return {};
+    }
+
+    /// Frames the device has been given but not yet played. 0 where the device can't tell.
+    virtual size_t delay(std::error_code& ec) {
+        ec.clear();
+        return 0;
+    }
+
+    /// Safe to call from any thread.
+    virtual output_stats stats() const {
+        return {};
+    }
+
   protected:
     asio::io_service& get_io_service() noexcept {
         return m_service;
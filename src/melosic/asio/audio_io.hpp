@@ -59,6 +59,10 @@ struct MELOSIC_EXPORT AudioOutputBase {
             BOOST_THROW_EXCEPTION(std::system_error(ec));
     }
 
+    template <typename PrepareHandler> void async_prepare(const AudioSpecs as, PrepareHandler&& handler) {
+        get_service().async_prepare(get_implementation(), as, std::forward<PrepareHandler>(handler));
+    }
+
     void play(std::error_code& ec) {
         get_service().play(get_implementation(), ec);
     }
@@ -115,6 +119,29 @@ struct MELOSIC_EXPORT AudioOutputBase {
         return get_service().current_specs(get_implementation());
     }
 
+    void latency(chrono::microseconds target) {
+        get_service().latency(get_implementation(), target);
+    }
+
+    size_t delay(std::error_code& ec) {
+        return get_service().delay(get_implementation(), ec);
+    }
+    size_t delay() {
+        std::error_code ec;
+        auto r = delay(ec);
+        if(ec)
+            BOOST_THROW_EXCEPTION(std::system_error(ec));
+        return r;
+    }
+
+    output_buffering buffering() const {
+        return get_service().buffering(get_implementation());
+    }
+
+    output_stats stats() const {
+        return get_service().stats(get_implementation());
+    }
+
     Output::DeviceState state() const {
         return get_service().state(get_implementation());
     }
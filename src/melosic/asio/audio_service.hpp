@@ -78,7 +78,7 @@ template <typename AudioServiceImpl> struct MELOSIC_EXPORT AudioOutputService :
             ec = asio::error::make_error_code(asio::error::no_buffer_space);
             return 0;
         }
-        return impl->write_some(*buf.begin(), ec);
+        return impl->write_some(gather(buf), ec);
     }
     size_t write_some(implementation_type& impl, const asio::const_buffer& buf, std::error_code& ec) {
         return impl->write_some(buf, ec);
@@ -92,6 +92,22 @@ template <typename AudioServiceImpl> struct MELOSIC_EXPORT AudioOutputService :
         return impl->current_specs();
     }
 
+    void latency(implementation_type& impl, chrono::microseconds target) {
+        impl->latency(target);
+    }
+
+    size_t delay(implementation_type& impl, std::error_code& ec) {
+        return impl->delay(ec);
+    }
+
+    output_buffering buffering(const implementation_type& impl) const {
+        return impl->buffering();
+    }
+
+    output_stats stats(const implementation_type& impl) const {
+        return impl->stats();
+    }
+
     bool non_blocking(const implementation_type& impl) const {
         return impl->non_blocking();
     }
@@ -100,14 +116,31 @@ template <typename AudioServiceImpl> struct MELOSIC_EXPORT AudioOutputService :
     }
 
     template <typename PrepareHandler>
-    void async_prepare(implementation_type& impl, const AudioSpecs, PrepareHandler handler);
+    void async_prepare(implementation_type& impl, const AudioSpecs as, PrepareHandler&& handler) {
+        impl->async_prepare(as, std::forward<PrepareHandler>(handler));
+    }
 
     template <typename ConstBufferSequence, typename WriteHandler>
     void async_write_some(implementation_type& impl, const ConstBufferSequence& buf, WriteHandler&& handler) {
+        impl->async_write_some(gather(buf), std::forward<WriteHandler>(handler));
+    }
+    template <typename WriteHandler>
+    void async_write_some(implementation_type& impl, const asio::const_buffer& buf, WriteHandler&& handler) {
         impl->async_write_some(buf, std::forward<WriteHandler>(handler));
     }
 
   private:
+    /// The non-empty buffers of a sequence, as many as fit in one write.
+    template <typename ConstBufferSequence> static const_buffers gather(const ConstBufferSequence& seq) {
+        const_buffers bufs;
+        for(auto it = seq.begin(); it != seq.end() && bufs.size() < bufs.capacity(); ++it) {
+            const asio::const_buffer buf(*it);
+            if(asio::buffer_size(buf) > 0)
+                bufs.push_back(buf);
+        }
+        return bufs;
+    }
+
     void shutdown_service() override {
     }
 };
@@ -0,0 +1,113 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_HISTOGRAM_HPP
+#define MELOSIC_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+namespace Melosic {
+
+/// Lock-free histogram of unsigned values in power of two buckets, cheap enough to record from the audio path.
+///
+/// Bucket 0 counts zeros; bucket i counts values in [2^(i-1), 2^i).
+/// Recording and reading may happen concurrently; a summary is not an atomic snapshot of every bucket.
+class histogram final {
+  public:
+    static constexpr std::size_t bucket_count = 65;
+
+    struct summary {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::array<uint64_t, bucket_count> buckets{{0}};
+
+        double mean() const noexcept {
+            return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+        }
+
+        /// Upper bound of the bucket holding the p quantile, 0 <= p <= 1.
+        uint64_t percentile(double p) const noexcept {
+            if(count == 0)
+                return 0;
+            const auto rank = static_cast<uint64_t>(p * count);
+            uint64_t seen = 0;
+            for(std::size_t i = 0; i < bucket_count; ++i) {
+                seen += buckets[i];
+                if(seen > rank || seen == count)
+                    return std::min(upper_bound(i), max);
+            }
+            return max;
+        }
+    };
+
+    histogram() noexcept {
+        reset();
+    }
+
+    histogram(const histogram&) = delete;
+    histogram& operator=(const histogram&) = delete;
+
+    static std::size_t bucket(uint64_t value) noexcept {
+        return value == 0 ? 0 : 64 - __builtin_clzll(value);
+    }
+
+    static uint64_t upper_bound(std::size_t bucket) noexcept {
+        return bucket == 0 ? 0 : bucket >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << bucket) - 1;
+    }
+
+    void record(uint64_t value) noexcept {
+        m_buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        auto max = m_max.load(std::memory_order_relaxed);
+        while(value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            ;
+    }
+
+    summary read() const noexcept {
+        summary s;
+        s.count = m_count.load(std::memory_order_relaxed);
+        s.sum = m_sum.load(std::memory_order_relaxed);
+        s.max = m_max.load(std::memory_order_relaxed);
+        for(std::size_t i = 0; i < bucket_count; ++i)
+            s.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset() noexcept {
+        for(auto&& b : m_buckets)
+            b.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, bucket_count> m_buckets;
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_HISTOGRAM_HPP
@@ -0,0 +1,121 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_MAPPED_ISTREAM_HPP
+#define MELOSIC_MAPPED_ISTREAM_HPP
+
+#include <algorithm>
+#include <istream>
+#include <streambuf>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/filesystem/path.hpp>
+
+#include <melosic/common/common.hpp>
+
+namespace Melosic {
+
+/// A whole file mapped read-only into memory, read as a std::istream.
+/// Readers which know of it can use data() directly rather than copying out of the stream.
+class MELOSIC_EXPORT mapped_istream final : public std::istream {
+  public:
+    /// nullptr if the file can't be mapped, eg. it's empty or not a regular file.
+    static std::unique_ptr<mapped_istream> open(const boost::filesystem::path& path) {
+        const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            return nullptr;
+
+        struct stat st;
+        void* data = MAP_FAILED;
+        if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+            data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file open
+        ::close(fd);
+        if(data == MAP_FAILED)
+            return nullptr;
+
+        ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+        return std::unique_ptr<mapped_istream>(new mapped_istream(static_cast<char*>(data), st.st_size));
+    }
+
+    ~mapped_istream() {
+        ::munmap(m_buf.eback(), size());
+    }
+
+    const char* data() const noexcept {
+        return m_buf.eback();
+    }
+
+    std::size_t size() const noexcept {
+        return m_buf.egptr() - m_buf.eback();
+    }
+
+    /// Hints that [offset, offset + length) is about to be read, eg. after seeking.
+    void will_need(std::size_t offset, std::size_t length) const noexcept {
+        if(offset >= size())
+            return;
+        // must start on a page boundary
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const auto start = offset / page * page;
+        ::madvise(m_buf.eback() + start, std::min(length + offset - start, size() - start), MADV_WILLNEED);
+    }
+
+  private:
+    struct buf final : std::streambuf {
+        using std::streambuf::eback;
+        using std::streambuf::egptr;
+
+        buf(char* data, std::size_t size) {
+            setg(data, data, data + size);
+        }
+
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+            if(!(which & std::ios_base::in))
+                return pos_type(off_type(-1));
+            off_type pos;
+            if(dir == std::ios_base::beg)
+                pos = off;
+            else if(dir == std::ios_base::cur)
+                pos = gptr() - eback() + off;
+            else
+                pos = egptr() - eback() + off;
+            if(pos < 0 || pos > egptr() - eback())
+                return pos_type(off_type(-1));
+            setg(eback(), eback() + pos, egptr());
+            return pos_type(pos);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+    mapped_istream(char* data, std::size_t size) : std::istream(nullptr), m_buf(data, size) {
+        rdbuf(&m_buf);
+    }
+
+    buf m_buf;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_MAPPED_ISTREAM_HPP
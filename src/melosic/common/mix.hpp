@@ -0,0 +1,102 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_MIX_HPP
+#define MELOSIC_MIX_HPP
+
+#include <cmath>
+#include <cstddef>
+
+#include <melosic/common/sample_convert.hpp>
+
+namespace Melosic {
+
+/// Per-sample gains for frames [pos, pos + frames) of an equal-power fade lasting total frames.
+/// fade_out falls from 1 to 0 while fade_in rises from 0 to 1, with fade_out^2 + fade_in^2 == 1.
+/// Each gain is repeated for every channel of a frame, so both arrays hold frames * channels floats.
+inline void equal_power_gains(std::size_t pos, std::size_t total, std::size_t frames, unsigned channels,
+                              float* fade_out, float* fade_in) noexcept {
+    const double step = total ? (M_PI / 2) / total : 0;
+    // rotate (cos, sin) a frame at a time rather than calling both per frame
+    double c = std::cos(pos * step), s = std::sin(pos * step);
+    const double dc = std::cos(step), ds = std::sin(step);
+    for(std::size_t f = 0; f < frames; ++f) {
+        const bool done = pos + f >= total;
+        for(unsigned ch = 0; ch < channels; ++ch) {
+            *fade_out++ = done ? 0.0f : static_cast<float>(c);
+            *fade_in++ = done ? 1.0f : static_cast<float>(s);
+        }
+        const auto c_next = c * dc - s * ds;
+        s = s * dc + c * ds;
+        c = c_next;
+    }
+}
+
+namespace detail {
+namespace mix {
+
+inline void mix_scalar(const float* a, const float* ga, const float* b, const float* gb, float* dst,
+                       std::size_t n) noexcept {
+    for(std::size_t i = 0; i < n; ++i)
+        dst[i] = a[i] * ga[i] + b[i] * gb[i];
+}
+
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+
+__attribute__((target("sse2"))) inline std::size_t mix_sse2(const float* a, const float* ga, const float* b,
+                                                            const float* gb, float* dst, std::size_t n) noexcept {
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const auto x = _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(ga + i));
+        const auto y = _mm_mul_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(gb + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(x, y));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline std::size_t mix_avx2(const float* a, const float* ga, const float* b,
+                                                            const float* gb, float* dst, std::size_t n) noexcept {
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const auto x = _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(ga + i));
+        const auto y = _mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(gb + i));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(x, y));
+    }
+    return i;
+}
+
+#endif // MELOSIC_SAMPLE_CONVERT_X86
+
+} // namespace mix
+} // namespace detail
+
+/// dst[i] = a[i] * ga[i] + b[i] * gb[i] over n samples. dst may alias a or b.
+inline void mix_fade(const float* a, const float* ga, const float* b, const float* gb, float* dst, std::size_t n,
+                     simd_level level = best_simd_level()) noexcept {
+    std::size_t i = 0;
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+    if(level == simd_level::avx2)
+        i = detail::mix::mix_avx2(a, ga, b, gb, dst, n);
+    else if(level == simd_level::sse2)
+        i = detail::mix::mix_sse2(a, ga, b, gb, dst, n);
+#endif
+    detail::mix::mix_scalar(a + i, ga + i, b + i, gb + i, dst + i, n - i);
+}
+
+} // namespace Melosic
+
+#endif // MELOSIC_MIX_HPP
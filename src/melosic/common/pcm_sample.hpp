@@ -19,9 +19,16 @@
 #define MELOSIC_PCM_SAMPLE
 
 #include <array>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
 
 #include <boost/integer.hpp>
 
+#include <melosic/common/sample_convert.hpp>
+
 namespace Melosic {
 
 template <int bits> struct pcm_sample {
@@ -70,6 +77,72 @@ template <int bits> struct pcm_sample {
     std::array<char, (bits / 8) + (bits % 8 != 0)> arr{{0}};
 };
 
+/// Bytes taken by a packed sample of bits, eg. 12 bit audio is padded to 16.
+template <int bits> constexpr unsigned pcm_sample_bytes = bits / 8 + (bits % 8 != 0);
+
+/// Packs n interleaved, right-justified samples, as decoder libraries hand them out, into little-endian
+/// pcm_sample<bits>s. Equivalent to assigning each to a pcm_sample, at memory bandwidth for 16 and 24 bit.
+template <int bits> inline void pack(const int32_t* in, std::size_t n, void* out) noexcept {
+    static_assert(bits > 0 && bits <= 32, "");
+    static const auto fn = select_int_packer(pcm_sample_bytes<bits>);
+    fn(in, n, static_cast<char*>(out));
+}
+
+/// The inverse of pack(): sign extends n little-endian pcm_sample<bits>s to right-justified int32s.
+template <int bits> inline void unpack(const void* in, std::size_t n, int32_t* out) noexcept {
+    static_assert(bits > 0 && bits <= 32, "");
+    static const auto fn = select_int_unpacker(pcm_sample_bytes<bits>);
+    fn(static_cast<const char*>(in), n, out);
+}
+
+namespace detail {
+
+// Channels is either unsigned or a std::integral_constant, which lets the interleave loop unroll
+template <int bits, typename Channels>
+void pack_planar(const int32_t* const in[], Channels channels, std::size_t first, std::size_t frames,
+                 char* out) noexcept {
+    // interleave a block at a time into a buffer pack() can run over
+    alignas(32) int32_t block[256];
+    const std::size_t block_frames = sizeof(block) / sizeof(*block) / channels;
+    for(std::size_t done = 0; done < frames;) {
+        const auto count = std::min(block_frames, frames - done);
+        for(std::size_t i = 0; i < count; ++i)
+            for(unsigned c = 0; c < channels; ++c)
+                block[i * channels + c] = in[c][first + done + i];
+        pack<bits>(block, count * channels, out);
+        out += count * channels * pcm_sample_bytes<bits>;
+        done += count;
+    }
+}
+
+} // namespace detail
+
+/// Interleaves frames from first of each of channels planar, right-justified arrays, as libFLAC hands them out, and
+/// packs them as pack() does.
+template <int bits, unsigned channels>
+void pack_planar(const int32_t* const in[], std::size_t first, std::size_t frames, void* out) noexcept {
+    static_assert(channels > 0 && channels <= 256, "");
+    if(channels == 1)
+        pack<bits>(in[0] + first, frames, out);
+    else
+        detail::pack_planar<bits>(in, std::integral_constant<unsigned, channels>{}, first, frames,
+                                  static_cast<char*>(out));
+}
+
+/// pack_planar() for a channel count known only at runtime; mono and stereo are specialised.
+template <int bits>
+void pack_planar(const int32_t* const in[], unsigned channels, std::size_t first, std::size_t frames,
+                 void* out) noexcept {
+    switch(channels) {
+        case 1:
+            return pack_planar<bits, 1>(in, first, frames, out);
+        case 2:
+            return pack_planar<bits, 2>(in, first, frames, out);
+        default:
+            return detail::pack_planar<bits>(in, channels, first, frames, static_cast<char*>(out));
+    }
+}
+
 } // namespace Melosic
 
 #endif // MELOSIC_PCM_SAMPLE
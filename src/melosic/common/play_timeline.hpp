@@ -0,0 +1,183 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_PLAY_TIMELINE_HPP
+#define MELOSIC_PLAY_TIMELINE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+namespace chrono = std::chrono;
+
+#include <melosic/common/optional.hpp>
+
+namespace Melosic {
+
+/// Maps frames written to an output back to the source and position they were decoded from.
+///
+/// The producer commit()s runs of frames as they're queued; the consumer reports what the device has taken
+/// and how much of that it still holds, from which the frame being heard at any moment is estimated.
+/// Not thread-safe.
+template <typename Source> class play_timeline final {
+  public:
+    using clock = chrono::steady_clock;
+
+    struct position {
+        Source source;
+        chrono::microseconds pos;
+    };
+
+    play_timeline() = default;
+
+    explicit play_timeline(unsigned rate) : m_rate(rate) {
+    }
+
+    /// Forgets everything queued; for when the output is stopped or re-prepared.
+    void reset(unsigned rate) {
+        m_rate = rate;
+        m_segments.clear();
+        m_committed = m_written = m_delay = 0;
+        m_written_at = {};
+        m_running = false;
+    }
+
+    /// As reset(rate), with the estimate held at pos of source until frames are written; eg. after a seek.
+    void reset(unsigned rate, Source source, chrono::microseconds pos) {
+        reset(rate);
+        m_segments.push_back({0, {std::move(source), pos}});
+    }
+
+    unsigned rate() const noexcept {
+        return m_rate;
+    }
+
+    /// frames from source, beginning at pos, have been queued for the output.
+    void commit(Source source, chrono::microseconds pos, uint64_t frames) {
+        if(frames == 0)
+            return;
+        m_segments.push_back({m_committed, {std::move(source), pos}});
+        m_committed += frames;
+    }
+
+    /// The output has taken frames more, and delay frames of all it has taken are yet to be heard.
+    void written(uint64_t frames, uint64_t delay, clock::time_point now) {
+        m_written += frames;
+        m_delay = std::min(delay, m_written);
+        m_written_at = now;
+        m_running = true;
+        // keep the segment being heard; those before it have played out
+        const auto played = m_written - m_delay;
+        while(m_segments.size() > 1 && m_segments[1].frame <= played)
+            m_segments.pop_front();
+    }
+
+    /// The output dropped what it held, of which frames will be written again, eg. to another device.
+    /// The estimate holds at the first of them until the next written().
+    void rewind(uint64_t frames) {
+        m_written -= std::min(frames, m_written);
+        m_delay = 0;
+        m_running = false;
+    }
+
+    /// Stops the estimate advancing while the output is paused.
+    void pause(clock::time_point now) {
+        if(!m_running)
+            return;
+        m_delay = m_written - audible_frame(now);
+        m_running = false;
+    }
+
+    void resume(clock::time_point now) {
+        m_written_at = now;
+        m_running = true;
+    }
+
+    /// The frame being heard at now, counted from the last reset().
+    uint64_t audible_frame(clock::time_point now) const noexcept {
+        const auto played = m_written - m_delay;
+        if(!m_running || m_rate == 0)
+            return played;
+        const auto since = chrono::duration_cast<chrono::microseconds>(now - m_written_at).count();
+        return std::min(played + static_cast<uint64_t>(std::max<int64_t>(since, 0)) * m_rate / 1000000, m_written);
+    }
+
+    optional<position> audible(clock::time_point now) const {
+        const auto frame = audible_frame(now);
+        const auto it = segment_at(frame);
+        if(it == m_segments.end())
+            return nullopt;
+        auto p = it->at;
+        p.pos += frames_to_time(frame - it->frame);
+        return p;
+    }
+
+    /// audible(now), and how far on it will go before another written() is needed.
+    struct span {
+        position from;
+        // the estimate advances in real time from from.pos while running, up to the end of what the output was
+        // given or of from.source, whichever comes first
+        chrono::microseconds until;
+        bool running;
+    };
+
+    optional<span> audible_span(clock::time_point now) const {
+        const auto frame = audible_frame(now);
+        const auto it = segment_at(frame);
+        if(it == m_segments.end())
+            return nullopt;
+        auto end = m_written;
+        if(std::next(it) != m_segments.end())
+            end = std::min(end, std::next(it)->frame);
+        span s{it->at, {}, m_running};
+        s.from.pos += frames_to_time(frame - it->frame);
+        s.until = s.from.pos + frames_to_time(std::max(end, frame) - frame);
+        return s;
+    }
+
+  private:
+    // the segment frame falls in, or end() if none
+    auto segment_at(uint64_t frame) const {
+        auto it = std::upper_bound(m_segments.begin(), m_segments.end(), frame,
+                                   [](uint64_t f, auto&& segment) { return f < segment.frame; });
+        if(it == m_segments.begin() || m_rate == 0)
+            return m_segments.end();
+        return --it;
+    }
+
+    chrono::microseconds frames_to_time(uint64_t frames) const {
+        return chrono::microseconds(frames * 1000000 / m_rate);
+    }
+
+    struct segment {
+        uint64_t frame;
+        position at;
+    };
+
+    unsigned m_rate = 0;
+    std::deque<segment> m_segments;
+    uint64_t m_committed = 0;
+    uint64_t m_written = 0;
+    uint64_t m_delay = 0;
+    clock::time_point m_written_at;
+    bool m_running = false;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_PLAY_TIMELINE_HPP
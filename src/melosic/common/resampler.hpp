@@ -0,0 +1,263 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_RESAMPLER_HPP
+#define MELOSIC_RESAMPLER_HPP
+
+#include <cmath>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+
+#include <melosic/common/sample_convert.hpp>
+
+namespace Melosic {
+
+namespace detail {
+namespace resample {
+
+inline float dot_scalar(const float* a, const float* b, std::size_t n) noexcept {
+    float sum = 0.0f;
+    for(std::size_t i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+
+__attribute__((target("sse2"))) inline float dot_sse2(const float* a, const float* b, std::size_t n) noexcept {
+    auto acc = _mm_setzero_ps();
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dot_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline float dot_avx2(const float* a, const float* b, std::size_t n) noexcept {
+    auto acc = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, acc);
+    float sum = 0.0f;
+    for(auto lane : lanes)
+        sum += lane;
+    return sum + dot_scalar(a + i, b + i, n - i);
+}
+
+#endif // MELOSIC_SAMPLE_CONVERT_X86
+
+// modified Bessel function of the first kind, order 0
+inline double bessel_i0(double x) noexcept {
+    double sum = 1.0, term = 1.0;
+    for(int k = 1; k < 32; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+inline uint32_t gcd(uint32_t a, uint32_t b) noexcept {
+    while(b != 0) {
+        const auto r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+} // namespace resample
+} // namespace detail
+
+/// Windowed-sinc polyphase sample rate converter for interleaved float samples.
+///
+/// The rate ratio is reduced to up / down. One table of taps per phase is computed up front, so
+/// processing is only dot products. Ratios needing more than max_phases phases use the nearest
+/// phase; time is still stepped exactly.
+/// State persists across process() calls so consecutive blocks are continuous; reset() on seek.
+class resampler final {
+  public:
+    static constexpr unsigned max_phases = 4096;
+
+    resampler(unsigned channels, uint32_t from_rate, uint32_t to_rate, unsigned half_taps = 16,
+              simd_level level = best_simd_level())
+        : m_channels(channels),
+          m_from(from_rate),
+          m_to(to_rate),
+          m_taps(half_taps * 2),
+          m_level(level) {
+        assert(channels > 0 && from_rate > 0 && to_rate > 0 && half_taps > 0);
+        const auto g = detail::resample::gcd(from_rate, to_rate);
+        m_up = to_rate / g;
+        m_down = from_rate / g;
+        m_phases = std::min(m_up, unsigned{max_phases});
+
+        // cut off at the lower of the two Nyquist frequencies
+        const double cutoff = std::min(1.0, static_cast<double>(to_rate) / from_rate);
+        const double beta = 8.6;
+        const double i0_beta = detail::resample::bessel_i0(beta);
+        m_coeffs.resize(m_phases * m_taps);
+        for(unsigned p = 0; p < m_phases; ++p) {
+            const double frac = static_cast<double>(p) / m_phases;
+            for(unsigned k = 0; k < m_taps; ++k) {
+                const double d = static_cast<double>(k) - half_taps + 1 - frac;
+                const double x = cutoff * d * M_PI;
+                const double sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+                const double r = d / half_taps;
+                const double window =
+                    std::abs(r) >= 1.0 ? 0.0 : detail::resample::bessel_i0(beta * std::sqrt(1.0 - r * r)) / i0_beta;
+                m_coeffs[p * m_taps + k] = static_cast<float>(cutoff * sinc * window);
+            }
+        }
+        reset();
+    }
+
+    unsigned channels() const noexcept {
+        return m_channels;
+    }
+    uint32_t from_rate() const noexcept {
+        return m_from;
+    }
+    uint32_t to_rate() const noexcept {
+        return m_to;
+    }
+
+    /// Upper bound on frames produced by process() for in_frames input frames.
+    std::size_t max_output(std::size_t in_frames) const noexcept {
+        return static_cast<std::size_t>((static_cast<uint64_t>(in_frames) * m_up) / m_down) + 1;
+    }
+
+    /// Consumes all in_frames frames of in, writing up to max_output(in_frames) frames to out.
+    /// Returns frames written.
+    std::size_t process(const float* in, std::size_t in_frames, float* out) {
+        append(in, in_frames);
+
+        std::size_t produced = 0;
+        const unsigned half = m_taps / 2;
+        // window for output at m_pos covers [m_pos - half + 1, m_pos + half]
+        while(m_pos + half < m_len) {
+            const auto phase = static_cast<unsigned>((static_cast<uint64_t>(m_frac) * m_phases) / m_up);
+            const float* taps = m_coeffs.data() + phase * m_taps;
+            const auto start = m_pos + 1 - half;
+            for(unsigned ch = 0; ch < m_channels; ++ch)
+                *out++ = dot(channel(ch) + start, taps);
+            ++produced;
+
+            m_frac += m_down;
+            m_pos += m_frac / m_up;
+            m_frac %= m_up;
+        }
+
+        // keep only the history the next window needs
+        const auto keep_from = std::min<std::size_t>(m_pos + 1 - half, m_len);
+        if(keep_from > 0) {
+            for(unsigned ch = 0; ch < m_channels; ++ch)
+                std::copy(channel(ch) + keep_from, channel(ch) + m_len, channel(ch));
+            m_len -= keep_from;
+            m_pos -= keep_from;
+        }
+        return produced;
+    }
+
+    /// Upper bound on frames produced by flush().
+    std::size_t max_flush() const noexcept {
+        return max_output(m_taps / 2);
+    }
+
+    /// Completes the outputs whose windows reach past the end of input by padding it with silence, writing up
+    /// to max_flush() frames to out. Call at the end of a stream; the resampler is reset() after.
+    /// Returns frames written.
+    std::size_t flush(float* out) {
+        const unsigned half = m_taps / 2;
+        reserve(m_len + half);
+        for(unsigned ch = 0; ch < m_channels; ++ch)
+            std::fill(channel(ch) + m_len, channel(ch) + m_len + half, 0.0f);
+        m_len += half;
+        const auto produced = process(nullptr, 0, out);
+        reset();
+        return produced;
+    }
+
+    void reset() {
+        // prime with silence so the first output is centred on the first input frame
+        const unsigned half = m_taps / 2;
+        m_len = half - 1;
+        m_pos = half - 1;
+        m_frac = 0;
+        reserve(m_len);
+        std::fill(m_buf.begin(), m_buf.end(), 0.0f);
+    }
+
+  private:
+    float* channel(unsigned ch) noexcept {
+        return m_buf.data() + ch * m_capacity;
+    }
+
+    float dot(const float* x, const float* taps) const noexcept {
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+        if(m_level == simd_level::avx2)
+            return detail::resample::dot_avx2(x, taps, m_taps);
+        if(m_level == simd_level::sse2)
+            return detail::resample::dot_sse2(x, taps, m_taps);
+#endif
+        return detail::resample::dot_scalar(x, taps, m_taps);
+    }
+
+    // planar history, so each channel's window is contiguous
+    void append(const float* in, std::size_t frames) {
+        reserve(m_len + frames);
+        for(std::size_t f = 0; f < frames; ++f)
+            for(unsigned ch = 0; ch < m_channels; ++ch)
+                channel(ch)[m_len + f] = *in++;
+        m_len += frames;
+    }
+
+    // only grows
+    void reserve(std::size_t frames) {
+        if(frames <= m_capacity && !m_buf.empty())
+            return;
+        const auto capacity = std::max<std::size_t>(frames, m_taps * 2);
+        std::vector<float> buf(capacity * m_channels, 0.0f);
+        for(unsigned ch = 0; ch < m_channels && !m_buf.empty(); ++ch)
+            std::copy(channel(ch), channel(ch) + m_len, buf.data() + ch * capacity);
+        m_buf = std::move(buf);
+        m_capacity = capacity;
+    }
+
+    unsigned m_channels;
+    uint32_t m_from, m_to;
+    unsigned m_taps;
+    simd_level m_level;
+    uint32_t m_up = 1, m_down = 1;
+    unsigned m_phases = 1;
+    std::vector<float> m_coeffs;
+
+    std::vector<float> m_buf;
+    std::size_t m_capacity = 0;
+    std::size_t m_len = 0;
+    // output position; integer frame in m_buf plus m_frac / m_up
+    std::size_t m_pos = 0;
+    uint32_t m_frac = 0;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_RESAMPLER_HPP
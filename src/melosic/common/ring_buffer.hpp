@@ -0,0 +1,179 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_RING_BUFFER_HPP
+#define MELOSIC_RING_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <limits>
+
+#include <asio/buffer.hpp>
+
+namespace Melosic {
+
+constexpr std::size_t cache_line_size = 64;
+
+/// Fixed-capacity, lock-free single-producer/single-consumer byte ring.
+///
+/// Storage is only (re)allocated by reset(), never by the producer or consumer.
+/// The interface mirrors asio::streambuf: the producer fills prepare() and commit()s,
+/// the consumer reads data() and consume()s. Both return up to two regions, the second
+/// being non-empty only when the readable/writable span wraps around the end of storage.
+///
+/// A reserve of capacity can be kept from the producer, so that much of what was last consumed stays intact
+/// and can be rewind()ed, eg. to replay what a device held when it was swapped for another.
+class spsc_ring_buffer final {
+  public:
+    using mutable_buffers_type = std::array<asio::mutable_buffer, 2>;
+    using const_buffers_type = std::array<asio::const_buffer, 2>;
+
+    spsc_ring_buffer() noexcept = default;
+
+    explicit spsc_ring_buffer(std::size_t capacity) {
+        reset(capacity);
+    }
+
+    spsc_ring_buffer(const spsc_ring_buffer&) = delete;
+    spsc_ring_buffer& operator=(const spsc_ring_buffer&) = delete;
+
+    /// Not thread-safe. Neither producer nor consumer may be active.
+    void reset(std::size_t capacity, std::size_t reserve = 0) {
+        assert(reserve <= capacity);
+        m_reserve = reserve;
+        if(capacity != m_capacity) {
+            m_storage.reset(capacity > 0 ? new char[capacity + cache_line_size - 1] : nullptr);
+            void* ptr = m_storage.get();
+            std::size_t space = capacity + cache_line_size - 1;
+            m_data = capacity > 0 ? static_cast<char*>(std::align(cache_line_size, capacity, ptr, space)) : nullptr;
+            m_capacity = capacity;
+        }
+        clear();
+    }
+
+    /// Not thread-safe. Neither producer nor consumer may be active.
+    void clear() noexcept {
+        m_write_idx.store(0, std::memory_order_relaxed);
+        m_read_idx.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t capacity() const noexcept {
+        return m_capacity;
+    }
+
+    std::size_t reserve() const noexcept {
+        return m_reserve;
+    }
+
+    std::size_t size() const noexcept {
+        return m_write_idx.load(std::memory_order_acquire) - m_read_idx.load(std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    // producer
+
+    std::size_t write_available() const noexcept {
+        const auto used =
+            m_write_idx.load(std::memory_order_relaxed) - m_read_idx.load(std::memory_order_acquire) + m_reserve;
+        return used >= m_capacity ? 0 : m_capacity - used;
+    }
+
+    mutable_buffers_type prepare(std::size_t n) noexcept {
+        const auto w = m_write_idx.load(std::memory_order_relaxed);
+        n = std::min(n, write_available());
+        const auto off = m_capacity ? w % m_capacity : 0;
+        const auto first = std::min(n, m_capacity - off);
+        return {{asio::mutable_buffer(m_data + off, first), asio::mutable_buffer(m_data, n - first)}};
+    }
+
+    void commit(std::size_t n) noexcept {
+        assert(n <= write_available());
+        m_write_idx.store(m_write_idx.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    std::size_t write(const void* src, std::size_t n) noexcept {
+        std::size_t written = 0;
+        for(auto&& region : prepare(n)) {
+            std::memcpy(asio::buffer_cast<void*>(region), static_cast<const char*>(src) + written,
+                        asio::buffer_size(region));
+            written += asio::buffer_size(region);
+        }
+        commit(written);
+        return written;
+    }
+
+    // consumer
+
+    std::size_t read_available() const noexcept {
+        return m_write_idx.load(std::memory_order_acquire) - m_read_idx.load(std::memory_order_relaxed);
+    }
+
+    const_buffers_type data(std::size_t n = std::numeric_limits<std::size_t>::max()) const noexcept {
+        const auto r = m_read_idx.load(std::memory_order_relaxed);
+        n = std::min(n, read_available());
+        const auto off = m_capacity ? r % m_capacity : 0;
+        const auto first = std::min(n, m_capacity - off);
+        return {{asio::const_buffer(m_data + off, first), asio::const_buffer(m_data, n - first)}};
+    }
+
+    /// Advances the read index; a partial write only needs to consume what was written.
+    void consume(std::size_t n) noexcept {
+        n = std::min(n, read_available());
+        m_read_idx.store(m_read_idx.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /// Makes up to n of the most recently consumed bytes readable again, returning how many.
+    /// Only bytes the producer hasn't since overwritten can be; the producer must not be active.
+    std::size_t rewind(std::size_t n) noexcept {
+        const auto r = m_read_idx.load(std::memory_order_relaxed);
+        n = std::min({n, r, m_capacity - size()});
+        m_read_idx.store(r - n, std::memory_order_release);
+        return n;
+    }
+
+    std::size_t read(void* dst, std::size_t n) noexcept {
+        std::size_t read = 0;
+        for(auto&& region : data(n)) {
+            std::memcpy(static_cast<char*>(dst) + read, asio::buffer_cast<const void*>(region),
+                        asio::buffer_size(region));
+            read += asio::buffer_size(region);
+        }
+        consume(read);
+        return read;
+    }
+
+  private:
+    // indices only ever increase; position in storage is index % capacity
+    alignas(cache_line_size) std::atomic<std::size_t> m_write_idx{0};
+    alignas(cache_line_size) std::atomic<std::size_t> m_read_idx{0};
+
+    alignas(cache_line_size) std::unique_ptr<char[]> m_storage;
+    char* m_data = nullptr;
+    std::size_t m_capacity = 0;
+    std::size_t m_reserve = 0;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_RING_BUFFER_HPP
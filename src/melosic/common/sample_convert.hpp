@@ -0,0 +1,762 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_SAMPLE_CONVERT_HPP
+#define MELOSIC_SAMPLE_CONVERT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MELOSIC_SAMPLE_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Melosic {
+
+/// Interleaved, little-endian sample formats.
+/// s24_3 is packed into 3 bytes; s24_4 is 24 bits in the low bytes of 32.
+enum class sample_format : uint8_t { s8, s16, s24_3, s24_4, s32, f32 };
+
+constexpr std::size_t sample_size(sample_format fmt) noexcept {
+    switch(fmt) {
+        case sample_format::s8:
+            return 1;
+        case sample_format::s16:
+            return 2;
+        case sample_format::s24_3:
+            return 3;
+        case sample_format::s24_4:
+        case sample_format::s32:
+        case sample_format::f32:
+            return 4;
+    }
+    return 0;
+}
+
+/// Significant bits; float counts as 32 as it is never narrowed to.
+constexpr uint8_t sample_bits(sample_format fmt) noexcept {
+    switch(fmt) {
+        case sample_format::s8:
+            return 8;
+        case sample_format::s16:
+            return 16;
+        case sample_format::s24_3:
+        case sample_format::s24_4:
+            return 24;
+        case sample_format::s32:
+        case sample_format::f32:
+            return 32;
+    }
+    return 0;
+}
+
+/// Integer format for AudioSpecs::bps, as produced by decoders (24 bit is packed).
+constexpr sample_format sample_format_from_bps(uint8_t bps) noexcept {
+    return bps <= 8 ? sample_format::s8 : bps <= 16 ? sample_format::s16 : bps <= 24 ? sample_format::s24_3
+                                                                                     : sample_format::s32;
+}
+
+enum class dither { none, tpdf };
+
+enum class simd_level { scalar, sse2, avx2 };
+
+/// Best instruction set supported by the running CPU.
+inline simd_level best_simd_level() noexcept {
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+    static const simd_level level = [] {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return simd_level::avx2;
+        if(__builtin_cpu_supports("sse2"))
+            return simd_level::sse2;
+        return simd_level::scalar;
+    }();
+    return level;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+namespace detail {
+namespace convert {
+
+// Every conversion pivots through left-justified int32 samples.
+
+constexpr float pivot_scale = 2147483648.0f;
+// largest float below 2^31
+constexpr float pivot_max_float = 2147483520.0f;
+
+inline int32_t load_s32(const char* p) noexcept {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void store_s32(char* p, int32_t v) noexcept {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+/// Round to nearest and saturate a pivot sample to bits.
+inline int32_t narrow(int32_t v, unsigned bits) noexcept {
+    const int32_t r = ((v >> (32 - bits - 1)) + 1) >> 1;
+    return std::min(r, static_cast<int32_t>((1u << (bits - 1)) - 1));
+}
+
+inline void to_pivot_scalar(sample_format fmt, const char* in, int32_t* out, std::size_t n) noexcept {
+    switch(fmt) {
+        case sample_format::s8:
+            for(std::size_t i = 0; i < n; ++i)
+                out[i] = static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint8_t>(in[i])) << 24);
+            break;
+        case sample_format::s16:
+            for(std::size_t i = 0; i < n; ++i) {
+                int16_t v;
+                std::memcpy(&v, in + i * 2, sizeof(v));
+                out[i] = static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint16_t>(v)) << 16);
+            }
+            break;
+        case sample_format::s24_3:
+            for(std::size_t i = 0; i < n; ++i) {
+                const auto p = reinterpret_cast<const uint8_t*>(in + i * 3);
+                out[i] = static_cast<int32_t>((uint32_t(p[0]) << 8) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 24));
+            }
+            break;
+        case sample_format::s24_4:
+            for(std::size_t i = 0; i < n; ++i)
+                out[i] = static_cast<int32_t>(static_cast<uint32_t>(load_s32(in + i * 4)) << 8);
+            break;
+        case sample_format::s32:
+            std::memcpy(out, in, n * 4);
+            break;
+        case sample_format::f32:
+            for(std::size_t i = 0; i < n; ++i) {
+                float v;
+                std::memcpy(&v, in + i * 4, sizeof(v));
+                v = std::min(std::max(v * pivot_scale, -pivot_scale), pivot_max_float);
+                out[i] = static_cast<int32_t>(__builtin_lrintf(v));
+            }
+            break;
+    }
+}
+
+inline void from_pivot_scalar(sample_format fmt, const int32_t* in, char* out, std::size_t n) noexcept {
+    switch(fmt) {
+        case sample_format::s8:
+            for(std::size_t i = 0; i < n; ++i)
+                out[i] = static_cast<char>(narrow(in[i], 8));
+            break;
+        case sample_format::s16:
+            for(std::size_t i = 0; i < n; ++i) {
+                const auto v = static_cast<int16_t>(narrow(in[i], 16));
+                std::memcpy(out + i * 2, &v, sizeof(v));
+            }
+            break;
+        case sample_format::s24_3:
+            for(std::size_t i = 0; i < n; ++i) {
+                const auto v = static_cast<uint32_t>(narrow(in[i], 24));
+                out[i * 3] = static_cast<char>(v);
+                out[i * 3 + 1] = static_cast<char>(v >> 8);
+                out[i * 3 + 2] = static_cast<char>(v >> 16);
+            }
+            break;
+        case sample_format::s24_4:
+            for(std::size_t i = 0; i < n; ++i)
+                store_s32(out + i * 4, narrow(in[i], 24));
+            break;
+        case sample_format::s32:
+            std::memcpy(out, in, n * 4);
+            break;
+        case sample_format::f32:
+            for(std::size_t i = 0; i < n; ++i) {
+                const float v = static_cast<float>(in[i]) * (1.0f / pivot_scale);
+                std::memcpy(out + i * 4, &v, sizeof(v));
+            }
+            break;
+    }
+}
+
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+
+// SSE2 and AVX2 kernels cover the common formats; anything else falls back to scalar.
+// Each handles whole vectors only and returns the number of samples converted.
+
+// Packed 24 bit moves 8 samples at a time as two 12 byte halves with AVX2. Every 16 byte load or store touches
+// 4 bytes past its 12; loops stop while 12 samples remain to stay in bounds.
+constexpr std::size_t s24_3_slack = 12;
+
+// SSE2 has no pshufb, so 4 samples at a time are shifted into place within 64 bit lanes instead.
+// Loads and stores are of exactly 12 bytes, so need no slack.
+
+// each sample into the high 3 bytes of an int32, ie. left-justified
+__attribute__((target("sse2"))) inline __m128i load_s24_3_sse2(const char* in) noexcept {
+    int32_t last;
+    std::memcpy(&last, in + 8, 4);
+    const auto r = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)), _mm_cvtsi32_si128(last));
+    // samples 0 and 1 in the low lane, 2 and 3 in the high
+    const auto p = _mm_unpacklo_epi64(r, _mm_srli_si128(r, 6));
+    const auto first = _mm_set1_epi64x(0xffffff00);
+    const auto second = _mm_set1_epi64x(static_cast<int64_t>(0xffffff0000000000));
+    return _mm_or_si128(_mm_and_si128(_mm_slli_epi64(p, 8), first), _mm_and_si128(_mm_slli_epi64(p, 16), second));
+}
+
+// the low 3 bytes of each int32
+__attribute__((target("sse2"))) inline void store_s24_3_sse2(char* out, __m128i v) noexcept {
+    const auto first = _mm_set1_epi64x(0xffffff);
+    const auto second = _mm_set1_epi64x(0xffffff000000);
+    // samples 0 and 1, then 2 and 3, as the low 6 bytes of each lane
+    const auto p = _mm_or_si128(_mm_and_si128(v, first), _mm_and_si128(_mm_srli_epi64(v, 8), second));
+    const auto r = _mm_or_si128(_mm_move_epi64(p), _mm_slli_si128(_mm_srli_si128(p, 8), 6));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), r);
+    const int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+    std::memcpy(out + 8, &last, 4);
+}
+
+// each sample into the high 3 bytes of an int32, ie. left-justified
+__attribute__((target("avx2"))) inline __m256i load_s24_3_avx2(const char* in) noexcept {
+    const auto shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, //
+                                          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    const auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12));
+    return _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuffle);
+}
+
+// the low 3 bytes of each int32
+__attribute__((target("avx2"))) inline void store_s24_3_avx2(char* out, __m256i v) noexcept {
+    const auto shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, //
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    v = _mm256_shuffle_epi8(v, shuffle);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm256_extracti128_si256(v, 1));
+}
+
+__attribute__((target("sse2"))) inline std::size_t to_pivot_sse2(sample_format fmt, const char* in, int32_t* out,
+                                                                 std::size_t n) noexcept {
+    std::size_t i = 0;
+    switch(fmt) {
+        case sample_format::s16:
+            for(; i + 8 <= n; i += 8) {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+                const auto zero = _mm_setzero_si128();
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(zero, v));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(zero, v));
+            }
+            break;
+        case sample_format::s24_3:
+            for(; i + 4 <= n; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), load_s24_3_sse2(in + i * 3));
+            break;
+        case sample_format::s24_4:
+            for(; i + 4 <= n; i += 4) {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_slli_epi32(v, 8));
+            }
+            break;
+        case sample_format::f32: {
+            const auto scale = _mm_set1_ps(pivot_scale);
+            const auto lo = _mm_set1_ps(-pivot_scale);
+            const auto hi = _mm_set1_ps(pivot_max_float);
+            for(; i + 4 <= n; i += 4) {
+                auto v = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(in + i * 4)), scale);
+                v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_epi32(v));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) inline std::size_t from_pivot_sse2(sample_format fmt, const int32_t* in, char* out,
+                                                                   std::size_t n) noexcept {
+    std::size_t i = 0;
+    switch(fmt) {
+        case sample_format::s16: {
+            const auto one = _mm_set1_epi32(1);
+            for(; i + 8 <= n; i += 8) {
+                auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+                a = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(a, 15), one), 1);
+                b = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(b, 15), one), 1);
+                // packs saturates the one value rounding can push out of range
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_packs_epi32(a, b));
+            }
+            break;
+        }
+        case sample_format::s24_3:
+        case sample_format::s24_4: {
+            const auto one = _mm_set1_epi32(1);
+            const auto max = _mm_set1_epi32((1 << 23) - 1);
+            for(; i + 4 <= n; i += 4) {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                v = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(v, 7), one), 1);
+                const auto over = _mm_cmpgt_epi32(v, max);
+                v = _mm_or_si128(_mm_andnot_si128(over, v), _mm_and_si128(over, max));
+                if(fmt == sample_format::s24_3)
+                    store_s24_3_sse2(out + i * 3, v);
+                else
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), v);
+            }
+            break;
+        }
+        case sample_format::f32: {
+            const auto scale = _mm_set1_ps(1.0f / pivot_scale);
+            for(; i + 4 <= n; i += 4) {
+                const auto v = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+                _mm_storeu_ps(reinterpret_cast<float*>(out + i * 4), _mm_mul_ps(v, scale));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline std::size_t to_pivot_avx2(sample_format fmt, const char* in, int32_t* out,
+                                                                 std::size_t n) noexcept {
+    std::size_t i = 0;
+    switch(fmt) {
+        case sample_format::s16:
+            for(; i + 8 <= n; i += 8) {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+                const auto w = _mm256_slli_epi32(_mm256_cvtepi16_epi32(v), 16);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), w);
+            }
+            break;
+        case sample_format::s24_3:
+            for(; i + s24_3_slack <= n; i += 8)
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), load_s24_3_avx2(in + i * 3));
+            break;
+        case sample_format::s24_4:
+            for(; i + 8 <= n; i += 8) {
+                const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 4));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_slli_epi32(v, 8));
+            }
+            break;
+        case sample_format::f32: {
+            const auto scale = _mm256_set1_ps(pivot_scale);
+            const auto lo = _mm256_set1_ps(-pivot_scale);
+            const auto hi = _mm256_set1_ps(pivot_max_float);
+            for(; i + 8 <= n; i += 8) {
+                auto v = _mm256_mul_ps(_mm256_loadu_ps(reinterpret_cast<const float*>(in + i * 4)), scale);
+                v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtps_epi32(v));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline std::size_t from_pivot_avx2(sample_format fmt, const int32_t* in, char* out,
+                                                                   std::size_t n) noexcept {
+    std::size_t i = 0;
+    switch(fmt) {
+        case sample_format::s16: {
+            const auto one = _mm256_set1_epi32(1);
+            for(; i + 16 <= n; i += 16) {
+                auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8));
+                a = _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(a, 15), one), 1);
+                b = _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(b, 15), one), 1);
+                // packs works within 128 bit lanes; restore sample order afterwards
+                const auto p = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2), p);
+            }
+            break;
+        }
+        case sample_format::s24_3: {
+            const auto one = _mm256_set1_epi32(1);
+            const auto max = _mm256_set1_epi32((1 << 23) - 1);
+            for(; i + s24_3_slack <= n; i += 8) {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                v = _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(v, 7), one), 1);
+                store_s24_3_avx2(out + i * 3, _mm256_min_epi32(v, max));
+            }
+            break;
+        }
+        case sample_format::s24_4: {
+            const auto one = _mm256_set1_epi32(1);
+            const auto max = _mm256_set1_epi32((1 << 23) - 1);
+            for(; i + 8 <= n; i += 8) {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                v = _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(v, 7), one), 1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), _mm256_min_epi32(v, max));
+            }
+            break;
+        }
+        case sample_format::f32: {
+            const auto scale = _mm256_set1_ps(1.0f / pivot_scale);
+            for(; i + 8 <= n; i += 8) {
+                const auto v = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+                _mm256_storeu_ps(reinterpret_cast<float*>(out + i * 4), _mm256_mul_ps(v, scale));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return i;
+}
+
+#endif // MELOSIC_SAMPLE_CONVERT_X86
+
+} // namespace convert
+} // namespace detail
+
+/// Converts interleaved samples between sample_formats, writing straight into the caller's buffer.
+///
+/// Narrowing rounds to nearest, or adds TPDF dither of +-1 LSB of the destination format first.
+/// Kernels are chosen once, at construction, from the running CPU unless a simd_level is forced.
+class sample_converter final {
+  public:
+    sample_converter() noexcept : sample_converter(sample_format::s16, sample_format::s16) {
+    }
+
+    sample_converter(sample_format from, sample_format to, dither d = dither::none,
+                     simd_level level = best_simd_level()) noexcept
+        : m_from(from),
+          m_to(to),
+          m_dither(d == dither::tpdf && sample_bits(to) < sample_bits(from)),
+          m_level(level) {
+    }
+
+    sample_format from() const noexcept {
+        return m_from;
+    }
+    sample_format to() const noexcept {
+        return m_to;
+    }
+
+    /// Converts n samples (not frames) from src into dst, which must hold n * sample_size(to()) bytes.
+    /// Returns bytes written.
+    std::size_t convert(const void* src, std::size_t n, void* dst) noexcept {
+        auto in = static_cast<const char*>(src);
+        auto out = static_cast<char*>(dst);
+        const auto in_size = sample_size(m_from);
+        const auto out_size = sample_size(m_to);
+
+        if(m_from == m_to) {
+            std::memcpy(out, in, n * in_size);
+            return n * out_size;
+        }
+
+        alignas(32) int32_t pivot[block_size];
+        for(std::size_t done = 0; done < n;) {
+            const auto count = std::min(std::size_t{block_size}, n - done);
+            to_pivot(in + done * in_size, pivot, count);
+            if(m_dither)
+                add_dither(pivot, count);
+            from_pivot(pivot, out + done * out_size, count);
+            done += count;
+        }
+        return n * out_size;
+    }
+
+  private:
+    static constexpr std::size_t block_size = 256;
+
+    void to_pivot(const char* in, int32_t* out, std::size_t n) const noexcept {
+        std::size_t i = 0;
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+        if(m_level == simd_level::avx2)
+            i = detail::convert::to_pivot_avx2(m_from, in, out, n);
+        else if(m_level == simd_level::sse2)
+            i = detail::convert::to_pivot_sse2(m_from, in, out, n);
+#endif
+        detail::convert::to_pivot_scalar(m_from, in + i * sample_size(m_from), out + i, n - i);
+    }
+
+    void from_pivot(const int32_t* in, char* out, std::size_t n) const noexcept {
+        std::size_t i = 0;
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+        if(m_level == simd_level::avx2)
+            i = detail::convert::from_pivot_avx2(m_to, in, out, n);
+        else if(m_level == simd_level::sse2)
+            i = detail::convert::from_pivot_sse2(m_to, in, out, n);
+#endif
+        detail::convert::from_pivot_scalar(m_to, in + i, out + i * sample_size(m_to), n - i);
+    }
+
+    // triangular noise from the sum of two uniform values, each up to 1 LSB of the destination
+    void add_dither(int32_t* samples, std::size_t n) noexcept {
+        const uint32_t lsb_mask = (1u << (32 - sample_bits(m_to))) - 1;
+        for(std::size_t i = 0; i < n; ++i) {
+            const int64_t noise = int64_t(next_random() & lsb_mask) + int64_t(next_random() & lsb_mask) - lsb_mask;
+            const int64_t v = samples[i] + noise;
+            samples[i] = static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(v, INT32_MIN), INT32_MAX));
+        }
+    }
+
+    // xorshift32
+    uint32_t next_random() noexcept {
+        m_rand ^= m_rand << 13;
+        m_rand ^= m_rand >> 17;
+        m_rand ^= m_rand << 5;
+        return m_rand;
+    }
+
+    sample_format m_from;
+    sample_format m_to;
+    bool m_dither;
+    simd_level m_level;
+    uint32_t m_rand = 2463534242u;
+};
+
+namespace detail {
+namespace convert {
+
+inline void int_to_float_scalar(const int32_t* in, std::size_t n, float scale, float* out) noexcept {
+    for(std::size_t i = 0; i < n; ++i)
+        out[i] = static_cast<float>(in[i]) * scale;
+}
+
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+
+__attribute__((target("sse2"))) inline std::size_t int_to_float_sse2(const int32_t* in, std::size_t n, float scale,
+                                                                     float* out) noexcept {
+    const auto s = _mm_set1_ps(scale);
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const auto v = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm_storeu_ps(out + i, _mm_mul_ps(v, s));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline std::size_t int_to_float_avx2(const int32_t* in, std::size_t n, float scale,
+                                                                     float* out) noexcept {
+    const auto s = _mm256_set1_ps(scale);
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const auto v = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(v, s));
+    }
+    return i;
+}
+
+#endif // MELOSIC_SAMPLE_CONVERT_X86
+
+} // namespace convert
+} // namespace detail
+
+/// Converts n right-justified samples of the given bit depth, as decoder libraries hand them out, to float.
+/// Equivalent to a sample_converter from the matching integer format to f32, without the pivot pass.
+inline void int_to_float(const int32_t* in, std::size_t n, unsigned bits, float* out,
+                         simd_level level = best_simd_level()) noexcept {
+    assert(bits > 0 && bits <= 32);
+    const float scale = 1.0f / static_cast<float>(uint64_t(1) << (bits - 1));
+    std::size_t i = 0;
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+    if(level == simd_level::avx2)
+        i = detail::convert::int_to_float_avx2(in, n, scale, out);
+    else if(level == simd_level::sse2)
+        i = detail::convert::int_to_float_sse2(in, n, scale, out);
+#else
+    (void)level;
+#endif
+    detail::convert::int_to_float_scalar(in + i, n - i, scale, out + i);
+}
+
+namespace detail {
+namespace convert {
+
+// Right-justified int32 samples to Bytes wide little-endian ones, truncating as pcm_sample does, and back.
+
+template <unsigned Bytes> inline void int_to_packed_scalar(const int32_t* in, std::size_t n, char* out) noexcept {
+    static_assert(Bytes > 0 && Bytes <= 4, "");
+    if(Bytes == 4) {
+        std::memcpy(out, in, n * 4);
+        return;
+    }
+    for(std::size_t i = 0; i < n; ++i) {
+        const auto v = static_cast<uint32_t>(in[i]);
+        for(unsigned b = 0; b < Bytes; ++b)
+            out[i * Bytes + b] = static_cast<char>(v >> (b * 8));
+    }
+}
+
+template <unsigned Bytes> inline void packed_to_int_scalar(const char* in, std::size_t n, int32_t* out) noexcept {
+    static_assert(Bytes > 0 && Bytes <= 4, "");
+    if(Bytes == 4) {
+        std::memcpy(out, in, n * 4);
+        return;
+    }
+    for(std::size_t i = 0; i < n; ++i) {
+        uint32_t v = 0;
+        for(unsigned b = 0; b < Bytes; ++b)
+            v |= uint32_t(static_cast<uint8_t>(in[i * Bytes + b])) << ((4 - Bytes + b) * 8);
+        out[i] = static_cast<int32_t>(v) >> ((4 - Bytes) * 8);
+    }
+}
+
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+
+__attribute__((target("sse2"))) inline void int_to_s16_sse2(const int32_t* in, std::size_t n, char* out) noexcept {
+    // drop the high halves rather than saturate; in range samples are unaffected
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_packs_epi32(a, b));
+    }
+    int_to_packed_scalar<2>(in + i, n - i, out + i * 2);
+}
+
+__attribute__((target("avx2"))) inline void int_to_s16_avx2(const int32_t* in, std::size_t n, char* out) noexcept {
+    std::size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8));
+        a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+        b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+        const auto p = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2), p);
+    }
+    int_to_packed_scalar<2>(in + i, n - i, out + i * 2);
+}
+
+__attribute__((target("sse2"))) inline void int_to_s24_3_sse2(const int32_t* in, std::size_t n, char* out) noexcept {
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        store_s24_3_sse2(out + i * 3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+    int_to_packed_scalar<3>(in + i, n - i, out + i * 3);
+}
+
+__attribute__((target("avx2"))) inline void int_to_s24_3_avx2(const int32_t* in, std::size_t n, char* out) noexcept {
+    std::size_t i = 0;
+    for(; i + s24_3_slack <= n; i += 8)
+        store_s24_3_avx2(out + i * 3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+    int_to_packed_scalar<3>(in + i, n - i, out + i * 3);
+}
+
+// and back, sign extending
+
+__attribute__((target("sse2"))) inline void s16_to_int_sse2(const char* in, std::size_t n, int32_t* out) noexcept {
+    const auto zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 16));
+    }
+    packed_to_int_scalar<2>(in + i * 2, n - i, out + i);
+}
+
+__attribute__((target("avx2"))) inline void s16_to_int_avx2(const char* in, std::size_t n, int32_t* out) noexcept {
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepi16_epi32(v));
+    }
+    packed_to_int_scalar<2>(in + i * 2, n - i, out + i);
+}
+
+__attribute__((target("sse2"))) inline void s24_3_to_int_sse2(const char* in, std::size_t n, int32_t* out) noexcept {
+    std::size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_srai_epi32(load_s24_3_sse2(in + i * 3), 8));
+    packed_to_int_scalar<3>(in + i * 3, n - i, out + i);
+}
+
+__attribute__((target("avx2"))) inline void s24_3_to_int_avx2(const char* in, std::size_t n, int32_t* out) noexcept {
+    std::size_t i = 0;
+    for(; i + s24_3_slack <= n; i += 8)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_srai_epi32(load_s24_3_avx2(in + i * 3), 8));
+    packed_to_int_scalar<3>(in + i * 3, n - i, out + i);
+}
+
+#endif // MELOSIC_SAMPLE_CONVERT_X86
+
+} // namespace convert
+} // namespace detail
+
+using int_packer = void (*)(const int32_t* in, std::size_t n, char* out);
+
+/// Packs n right-justified samples, as decoder libraries hand them out, into bytes wide little-endian samples.
+/// Meant to be chosen once per stream; returns nullptr for widths other than 1-4 bytes.
+inline int_packer select_int_packer(unsigned bytes, simd_level level = best_simd_level()) noexcept {
+    switch(bytes) {
+        case 1:
+            return &detail::convert::int_to_packed_scalar<1>;
+        case 2:
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+            if(level == simd_level::avx2)
+                return &detail::convert::int_to_s16_avx2;
+            if(level == simd_level::sse2)
+                return &detail::convert::int_to_s16_sse2;
+#endif
+            return &detail::convert::int_to_packed_scalar<2>;
+        case 3:
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+            if(level == simd_level::avx2)
+                return &detail::convert::int_to_s24_3_avx2;
+            if(level == simd_level::sse2)
+                return &detail::convert::int_to_s24_3_sse2;
+#endif
+            return &detail::convert::int_to_packed_scalar<3>;
+        case 4:
+            return &detail::convert::int_to_packed_scalar<4>;
+        default:
+            (void)level;
+            return nullptr;
+    }
+}
+
+using int_unpacker = void (*)(const char* in, std::size_t n, int32_t* out);
+
+/// The inverse of select_int_packer(): sign extends n bytes wide little-endian samples to right-justified int32.
+inline int_unpacker select_int_unpacker(unsigned bytes, simd_level level = best_simd_level()) noexcept {
+    switch(bytes) {
+        case 1:
+            return &detail::convert::packed_to_int_scalar<1>;
+        case 2:
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+            if(level == simd_level::avx2)
+                return &detail::convert::s16_to_int_avx2;
+            if(level == simd_level::sse2)
+                return &detail::convert::s16_to_int_sse2;
+#endif
+            return &detail::convert::packed_to_int_scalar<2>;
+        case 3:
+#ifdef MELOSIC_SAMPLE_CONVERT_X86
+            if(level == simd_level::avx2)
+                return &detail::convert::s24_3_to_int_avx2;
+            if(level == simd_level::sse2)
+                return &detail::convert::s24_3_to_int_sse2;
+#endif
+            return &detail::convert::packed_to_int_scalar<3>;
+        case 4:
+            return &detail::convert::packed_to_int_scalar<4>;
+        default:
+            (void)level;
+            return nullptr;
+    }
+}
+
+} // namespace Melosic
+
+#endif // MELOSIC_SAMPLE_CONVERT_HPP
@@ -0,0 +1,104 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_SEEK_INDEX_HPP
+#define MELOSIC_SEEK_INDEX_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <melosic/common/optional.hpp>
+
+namespace Melosic {
+
+/// A frame (sample per channel) at which decoding can begin and the byte offset in the stream it begins at.
+struct seek_point {
+    uint64_t sample;
+    uint64_t offset;
+
+    bool operator==(const seek_point& b) const noexcept {
+        return sample == b.sample && offset == b.offset;
+    }
+};
+
+/// Sorted seek points, at least spacing samples apart, gathered while decoding.
+///
+/// Lets a decoder go straight to a known offset rather than searching the stream for one.
+/// Points may arrive out of order, eg. while decoding after a seek; any too close to an existing point are dropped.
+class seek_index final {
+  public:
+    seek_index() noexcept = default;
+
+    explicit seek_index(uint64_t spacing, std::vector<seek_point> points = {})
+        : m_spacing(spacing), m_points(std::move(points)) {
+        std::sort(m_points.begin(), m_points.end(), [](auto&& a, auto&& b) { return a.sample < b.sample; });
+    }
+
+    uint64_t spacing() const noexcept {
+        return m_spacing;
+    }
+
+    const std::vector<seek_point>& points() const noexcept {
+        return m_points;
+    }
+
+    bool empty() const noexcept {
+        return m_points.empty();
+    }
+
+    std::size_t size() const noexcept {
+        return m_points.size();
+    }
+
+    /// Returns whether the point was kept.
+    bool add(seek_point point) {
+        auto it = lower_bound(point.sample);
+        if(it != m_points.end() && it->sample - point.sample < m_spacing)
+            return false;
+        if(it != m_points.begin() && point.sample - std::prev(it)->sample < m_spacing)
+            return false;
+        m_points.insert(it, point);
+        return true;
+    }
+
+    /// The last point at or before sample, provided it is no more than twice spacing before it.
+    /// Anything further away would mean decoding too far to be worth it.
+    optional<seek_point> find(uint64_t sample) const {
+        auto it = std::upper_bound(m_points.begin(), m_points.end(), sample,
+                                   [](uint64_t s, auto&& point) { return s < point.sample; });
+        if(it == m_points.begin())
+            return nullopt;
+        --it;
+        if(sample - it->sample > m_spacing * 2)
+            return nullopt;
+        return *it;
+    }
+
+  private:
+    std::vector<seek_point>::iterator lower_bound(uint64_t sample) {
+        return std::lower_bound(m_points.begin(), m_points.end(), sample,
+                                [](auto&& point, uint64_t s) { return point.sample < s; });
+    }
+
+    uint64_t m_spacing = 0;
+    std::vector<seek_point> m_points;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_SEEK_INDEX_HPP
@@ -0,0 +1,85 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_SEQLOCK_HPP
+#define MELOSIC_SEQLOCK_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace Melosic {
+
+/// A small trivially copyable value published by one writer at a time and read lock-free by any number of threads.
+///
+/// Readers never block the writer; they retry a load() that overlapped a store(), so suit values read often and
+/// written less so. Concurrent store()s must be serialised by the caller.
+template <typename T> class seqlock final {
+    static_assert(std::is_trivially_copyable<T>::value, "seqlock values are copied bytewise");
+
+  public:
+    seqlock() noexcept : seqlock(T{}) {
+    }
+
+    explicit seqlock(const T& value) noexcept {
+        store(value);
+    }
+
+    seqlock(const seqlock&) = delete;
+    seqlock& operator=(const seqlock&) = delete;
+
+    void store(const T& value) noexcept {
+        std::array<uint64_t, words> in{};
+        std::memcpy(in.data(), &value, sizeof(T));
+        // odd while writing
+        const auto seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(std::size_t i = 0; i < words; ++i)
+            m_data[i].store(in[i], std::memory_order_relaxed);
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const noexcept {
+        std::array<uint64_t, words> out;
+        while(true) {
+            const auto seq = m_seq.load(std::memory_order_acquire);
+            if(seq & 1)
+                continue;
+            for(std::size_t i = 0; i < words; ++i)
+                out[i] = m_data[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(m_seq.load(std::memory_order_relaxed) == seq)
+                break;
+        }
+        T value;
+        std::memcpy(&value, out.data(), sizeof(T));
+        return value;
+    }
+
+  private:
+    static constexpr std::size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> m_seq{0};
+    std::array<std::atomic<uint64_t>, words> m_data;
+};
+
+} // namespace Melosic
+
+#endif // MELOSIC_SEQLOCK_HPP
@@ -0,0 +1,75 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <melosic/common/histogram.hpp>
+using namespace Melosic;
+
+TEST_CASE("HistogramBuckets") {
+    CHECK(histogram::bucket(0) == 0u);
+    CHECK(histogram::bucket(1) == 1u);
+    CHECK(histogram::bucket(2) == 2u);
+    CHECK(histogram::bucket(3) == 2u);
+    CHECK(histogram::bucket(4) == 3u);
+    CHECK(histogram::bucket(UINT64_MAX) == 64u);
+    CHECK(histogram::upper_bound(3) == 7u);
+}
+
+TEST_CASE("HistogramSummary") {
+    histogram h;
+    for(uint64_t v = 1; v <= 100; ++v)
+        h.record(v);
+
+    auto s = h.read();
+    CHECK(s.count == 100u);
+    CHECK(s.sum == 5050u);
+    CHECK(s.max == 100u);
+    CHECK(s.mean() == Approx(50.5));
+    // 50th value lies in [32, 64)
+    CHECK(s.percentile(0.5) == 63u);
+    CHECK(s.percentile(1.0) == 100u);
+    CHECK(s.percentile(0.0) == 1u);
+
+    h.reset();
+    s = h.read();
+    CHECK(s.count == 0u);
+    CHECK(s.percentile(0.99) == 0u);
+}
+
+TEST_CASE("HistogramConcurrentRecord") {
+    histogram h;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+        threads.emplace_back([&h, t] {
+            for(uint64_t i = 0; i < 10000; ++i)
+                h.record(i + t);
+        });
+    for(auto&& t : threads)
+        t.join();
+
+    const auto s = h.read();
+    CHECK(s.count == 40000u);
+    CHECK(s.max == 10002u);
+    uint64_t total = 0;
+    for(auto b : s.buckets)
+        total += b;
+    CHECK(total == s.count);
+}
@@ -0,0 +1,60 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#include <vector>
+#include <iterator>
+
+#include <catch.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <melosic/common/mapped_istream.hpp>
+using namespace Melosic;
+
+TEST_CASE("MappedIstream") {
+    const boost::filesystem::path path{MELOSIC_TEST_DATA_DIR "/lossless_16_96000_1c.pcm"};
+    boost::filesystem::ifstream file{path};
+    const std::vector<char> expected{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    REQUIRE(!expected.empty());
+
+    auto mapped = mapped_istream::open(path);
+    REQUIRE(mapped);
+    REQUIRE(mapped->size() == expected.size());
+    CHECK(std::equal(expected.begin(), expected.end(), mapped->data()));
+
+    std::vector<char> buf(100);
+    CHECK(mapped->read(buf.data(), buf.size()));
+    CHECK(std::equal(buf.begin(), buf.end(), expected.begin()));
+    CHECK(mapped->tellg() == 100);
+
+    CHECK(mapped->seekg(-50, std::ios_base::end));
+    CHECK(mapped->read(buf.data(), buf.size()).gcount() == 50);
+    CHECK(std::equal(buf.begin(), buf.begin() + 50, expected.end() - 50));
+    CHECK(mapped->eof());
+
+    mapped->clear();
+    CHECK(mapped->seekg(10));
+    CHECK(mapped->get() == expected[10]);
+    CHECK(!mapped->seekg(expected.size() + 1));
+}
+
+TEST_CASE("MappedIstreamUnmappable") {
+    CHECK(!mapped_istream::open(MELOSIC_TEST_DATA_DIR "/does_not_exist"));
+    CHECK(!mapped_istream::open(MELOSIC_TEST_DATA_DIR));
+}
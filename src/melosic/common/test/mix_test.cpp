@@ -0,0 +1,77 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <vector>
+#include <random>
+
+#include <catch.hpp>
+
+#include <melosic/common/mix.hpp>
+using namespace Melosic;
+
+TEST_CASE("EqualPowerGains") {
+    constexpr std::size_t total = 1000;
+    std::vector<float> out(total * 2), in(total * 2);
+    equal_power_gains(0, total, total, 2, out.data(), in.data());
+
+    CHECK(out[0] == Approx(1.0f));
+    CHECK(in[0] == Approx(0.0f));
+    CHECK(out[1] == out[0]); // repeated per channel
+    CHECK(out[total] == Approx(std::sqrt(0.5f)));
+    CHECK(in[total] == Approx(std::sqrt(0.5f)));
+    for(std::size_t i = 0; i < out.size(); ++i)
+        CHECK(out[i] * out[i] + in[i] * in[i] == Approx(1.0f).epsilon(1e-4));
+
+    SECTION("resumes part way through") {
+        std::vector<float> out2(10), in2(10);
+        equal_power_gains(500, total, 5, 2, out2.data(), in2.data());
+        for(std::size_t i = 0; i < out2.size(); ++i) {
+            CHECK(out2[i] == Approx(out[1000 + i]).epsilon(1e-5));
+            CHECK(in2[i] == Approx(in[1000 + i]).epsilon(1e-5));
+        }
+    }
+
+    SECTION("past the end") {
+        float o, i;
+        equal_power_gains(total, total, 1, 1, &o, &i);
+        CHECK(o == 0.0f);
+        CHECK(i == 1.0f);
+    }
+}
+
+TEST_CASE("MixFadeSimdMatchesScalar") {
+    constexpr std::size_t n = 1027;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> a(n), b(n), ga(n), gb(n);
+    for(std::size_t i = 0; i < n; ++i) {
+        a[i] = dist(gen);
+        b[i] = dist(gen);
+        ga[i] = dist(gen);
+        gb[i] = dist(gen);
+    }
+
+    std::vector<float> expected(n);
+    mix_fade(a.data(), ga.data(), b.data(), gb.data(), expected.data(), n, simd_level::scalar);
+    for(auto level : {simd_level::sse2, simd_level::avx2}) {
+        if(static_cast<int>(level) > static_cast<int>(best_simd_level()))
+            continue;
+        std::vector<float> actual(n);
+        mix_fade(a.data(), ga.data(), b.data(), gb.data(), actual.data(), n, level);
+        CHECK(expected == actual);
+    }
+}
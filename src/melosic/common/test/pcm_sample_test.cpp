@@ -0,0 +1,106 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstring>
+
+#include <catch.hpp>
+
+#include <melosic/common/pcm_sample.hpp>
+using namespace Melosic;
+
+namespace {
+
+template <int bits> std::vector<int32_t> random_samples(std::size_t n) {
+    std::mt19937 gen(bits);
+    const int64_t max = (int64_t(1) << (bits - 1)) - 1;
+    std::uniform_int_distribution<int64_t> dist(-max - 1, max);
+    std::vector<int32_t> samples(n);
+    for(auto&& v : samples)
+        v = static_cast<int32_t>(dist(gen));
+    samples[0] = static_cast<int32_t>(-max - 1);
+    samples[1] = static_cast<int32_t>(max);
+    return samples;
+}
+
+// one pcm_sample at a time
+template <int bits> std::vector<char> reference_pack(const std::vector<int32_t>& in) {
+    std::vector<char> out(in.size() * pcm_sample_bytes<bits>);
+    for(std::size_t i = 0; i < in.size(); ++i) {
+        const pcm_sample<bits> s(in[i]);
+        std::memcpy(out.data() + i * pcm_sample_bytes<bits>, &s, pcm_sample_bytes<bits>);
+    }
+    return out;
+}
+
+template <int bits> void check_pack_round_trip() {
+    // odd length to cover the scalar tails
+    const auto in = random_samples<bits>(1021);
+    std::vector<char> packed(in.size() * pcm_sample_bytes<bits>);
+    pack<bits>(in.data(), in.size(), packed.data());
+    CHECK(packed == reference_pack<bits>(in));
+
+    std::vector<int32_t> unpacked(in.size());
+    unpack<bits>(packed.data(), in.size(), unpacked.data());
+    if(bits % 8 == 0)
+        CHECK(unpacked == in);
+}
+
+template <int bits, unsigned channels> void check_pack_planar() {
+    constexpr std::size_t frames = 777, first = 3;
+    std::vector<std::vector<int32_t>> planes;
+    std::vector<const int32_t*> in;
+    std::vector<int32_t> interleaved;
+    for(unsigned c = 0; c < channels; ++c)
+        planes.push_back(random_samples<bits>(frames + first));
+    for(auto&& plane : planes)
+        in.push_back(plane.data());
+    for(std::size_t i = first; i < frames + first; ++i)
+        for(auto&& plane : planes)
+            interleaved.push_back(plane[i]);
+    const auto expected = reference_pack<bits>(interleaved);
+
+    std::vector<char> out(expected.size());
+    pack_planar<bits, channels>(in.data(), first, frames, out.data());
+    CHECK(out == expected);
+
+    std::fill(out.begin(), out.end(), 0);
+    pack_planar<bits>(in.data(), channels, first, frames, out.data());
+    CHECK(out == expected);
+}
+
+} // namespace
+
+TEST_CASE("PCMSamplePack") {
+    check_pack_round_trip<8>();
+    check_pack_round_trip<12>();
+    check_pack_round_trip<16>();
+    check_pack_round_trip<20>();
+    check_pack_round_trip<24>();
+    check_pack_round_trip<32>();
+}
+
+TEST_CASE("PCMSamplePackPlanar") {
+    check_pack_planar<16, 1>();
+    check_pack_planar<16, 2>();
+    check_pack_planar<24, 2>();
+    check_pack_planar<24, 3>();
+    check_pack_planar<32, 6>();
+    check_pack_planar<8, 2>();
+}
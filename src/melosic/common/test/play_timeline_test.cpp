@@ -0,0 +1,140 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <string>
+
+#include <catch.hpp>
+
+#include <melosic/common/play_timeline.hpp>
+using namespace Melosic;
+
+TEST_CASE("PlayTimelineSegments") {
+    using clock = play_timeline<std::string>::clock;
+    play_timeline<std::string> t{1000};
+    const auto now = clock::now();
+    CHECK(!t.audible(now));
+
+    t.commit("a", chrono::seconds(10), 500);
+    t.commit("b", chrono::seconds(0), 1000);
+
+    // everything written is still queued in the device
+    t.written(1500, 1500, now);
+    auto p = t.audible(now);
+    REQUIRE(p);
+    CHECK(p->source == "a");
+    CHECK(p->pos == chrono::seconds(10));
+
+    t.written(0, 1250, now);
+    p = t.audible(now);
+    REQUIRE(p);
+    CHECK(p->source == "a");
+    CHECK(p->pos == chrono::milliseconds(10250));
+
+    // into the second source
+    t.written(0, 900, now);
+    p = t.audible(now);
+    REQUIRE(p);
+    CHECK(p->source == "b");
+    CHECK(p->pos == chrono::milliseconds(100));
+}
+
+TEST_CASE("PlayTimelineExtrapolate") {
+    using clock = play_timeline<int>::clock;
+    play_timeline<int> t{1000};
+    const auto now = clock::now();
+    t.commit(1, {}, 1000);
+    t.written(1000, 1000, now);
+
+    CHECK(t.audible_frame(now) == 0u);
+    CHECK(t.audible_frame(now + chrono::milliseconds(250)) == 250u);
+    // never past what the device was given
+    CHECK(t.audible_frame(now + chrono::seconds(5)) == 1000u);
+
+    t.pause(now + chrono::milliseconds(300));
+    CHECK(t.audible_frame(now + chrono::seconds(5)) == 300u);
+    t.resume(now + chrono::seconds(5));
+    CHECK(t.audible_frame(now + chrono::milliseconds(5100)) == 400u);
+
+    // a device swapped out holding 200 frames, of which 150 could be replayed
+    t.written(0, 200, now + chrono::seconds(6));
+    t.rewind(150);
+    CHECK(t.audible_frame(now + chrono::seconds(7)) == 850u);
+    t.written(150, 150, now + chrono::seconds(7));
+    CHECK(t.audible_frame(now + chrono::seconds(7)) == 850u);
+
+    t.reset(48000);
+    CHECK(t.rate() == 48000u);
+    CHECK(t.audible_frame(now) == 0u);
+    CHECK(!t.audible(now));
+}
+
+TEST_CASE("PlayTimelineResetTo") {
+    using clock = play_timeline<std::string>::clock;
+    play_timeline<std::string> t{1000};
+    const auto now = clock::now();
+    t.commit("a", chrono::seconds(10), 1000);
+    t.written(1000, 500, now);
+
+    // seeked; nothing of the new position queued yet
+    t.reset(1000, "a", chrono::seconds(60));
+    auto p = t.audible(now);
+    REQUIRE(p);
+    CHECK(p->pos == chrono::seconds(60));
+
+    t.commit("a", chrono::seconds(60), 1000);
+    t.written(1000, 1000, now);
+    CHECK(t.audible(now)->pos == chrono::seconds(60));
+    t.written(0, 750, now);
+    CHECK(t.audible(now)->pos == chrono::milliseconds(60250));
+}
+
+TEST_CASE("PlayTimelineSpan") {
+    using clock = play_timeline<std::string>::clock;
+    play_timeline<std::string> t{1000};
+    const auto now = clock::now();
+    CHECK(!t.audible_span(now));
+
+    t.commit("a", chrono::seconds(10), 500);
+    t.commit("b", chrono::seconds(0), 1000);
+    t.written(1500, 1250, now);
+
+    // runs on to the end of the first source
+    auto s = t.audible_span(now);
+    REQUIRE(s);
+    CHECK(s->from.source == "a");
+    CHECK(s->from.pos == chrono::milliseconds(10250));
+    CHECK(s->until == chrono::milliseconds(10500));
+    CHECK(s->running);
+
+    // then to the end of what was written
+    s = t.audible_span(now + chrono::milliseconds(500));
+    REQUIRE(s);
+    CHECK(s->from.source == "b");
+    CHECK(s->from.pos == chrono::milliseconds(250));
+    CHECK(s->until == chrono::seconds(1));
+
+    t.pause(now + chrono::milliseconds(500));
+    CHECK(!t.audible_span(now + chrono::seconds(1))->running);
+
+    // held at a seek until written to
+    t.reset(1000, "a", chrono::seconds(60));
+    s = t.audible_span(now);
+    REQUIRE(s);
+    CHECK(s->from.pos == chrono::seconds(60));
+    CHECK(s->until == chrono::seconds(60));
+    CHECK(!s->running);
+}
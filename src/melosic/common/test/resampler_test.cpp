@@ -0,0 +1,133 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <cmath>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <melosic/common/resampler.hpp>
+using namespace Melosic;
+
+namespace {
+
+std::vector<float> sine(double freq, uint32_t rate, std::size_t frames, unsigned channels) {
+    std::vector<float> buf(frames * channels);
+    for(std::size_t f = 0; f < frames; ++f)
+        for(unsigned ch = 0; ch < channels; ++ch)
+            buf[f * channels + ch] = static_cast<float>(0.5 * std::sin(2 * M_PI * freq * f / rate));
+    return buf;
+}
+
+} // namespace
+
+TEST_CASE("ResamplerSameRateIsPassthrough") {
+    const auto in = sine(1000, 48000, 1000, 2);
+    resampler r{2, 48000, 48000};
+    std::vector<float> out(r.max_output(1000) * 2);
+    const auto n = r.process(in.data(), 1000, out.data());
+
+    // the final half window of input is held back until more arrives
+    REQUIRE(n > 900);
+    for(std::size_t i = 0; i < n * 2; ++i)
+        CHECK(out[i] == Approx(in[i]).margin(1e-6));
+}
+
+TEST_CASE("ResamplerConvertsRate") {
+    for(auto rates :
+        {std::make_pair(44100u, 48000u), std::make_pair(48000u, 44100u), std::make_pair(44100u, 96000u)}) {
+        const std::size_t frames = 4410;
+        const auto in = sine(1000, rates.first, frames, 1);
+        resampler r{1, rates.first, rates.second};
+        std::vector<float> out(r.max_output(frames));
+        const auto n = r.process(in.data(), frames, out.data());
+        REQUIRE(n <= r.max_output(frames));
+        // less the half window held back
+        CHECK(n >= static_cast<std::size_t>((frames - 16) * double(rates.second) / rates.first));
+
+        // same tone at the new rate, past the start-up transient
+        for(std::size_t i = 64; i < n; ++i)
+            CHECK(out[i] == Approx(0.5 * std::sin(2 * M_PI * 1000 * i / rates.second)).margin(2e-3));
+    }
+}
+
+TEST_CASE("ResamplerBlocksAreContinuous") {
+    const std::size_t frames = 3000;
+    const auto in = sine(440, 44100, frames, 2);
+
+    resampler whole{2, 44100, 48000};
+    std::vector<float> expected(whole.max_output(frames) * 2);
+    expected.resize(whole.process(in.data(), frames, expected.data()) * 2);
+
+    resampler blocks{2, 44100, 48000};
+    std::vector<float> actual;
+    for(std::size_t f = 0; f < frames;) {
+        const auto block = std::min<std::size_t>(frames - f, 97);
+        std::vector<float> out(blocks.max_output(block) * 2);
+        const auto n = blocks.process(in.data() + f * 2, block, out.data());
+        REQUIRE(n <= blocks.max_output(block));
+        actual.insert(actual.end(), out.begin(), out.begin() + n * 2);
+        f += block;
+    }
+
+    REQUIRE(actual.size() == expected.size());
+    for(std::size_t i = 0; i < actual.size(); ++i)
+        CHECK(actual[i] == Approx(expected[i]).margin(1e-6));
+}
+
+TEST_CASE("ResamplerFlushCompletesInput") {
+    for(auto rates : {std::make_pair(48000u, 48000u), std::make_pair(44100u, 48000u), std::make_pair(48000u, 44100u)}) {
+        const std::size_t frames = 4410;
+        const auto in = sine(1000, rates.first, frames, 2);
+        resampler r{2, rates.first, rates.second};
+        std::vector<float> out((r.max_output(frames) + r.max_flush()) * 2);
+        auto n = r.process(in.data(), frames, out.data());
+        const auto flushed = r.flush(out.data() + n * 2);
+        REQUIRE(flushed <= r.max_flush());
+        n += flushed;
+
+        // every input frame has its output
+        const auto expected = static_cast<double>(frames) * rates.second / rates.first;
+        CHECK(n >= static_cast<std::size_t>(expected));
+        CHECK(n <= static_cast<std::size_t>(expected) + 1);
+        if(rates.first == rates.second)
+            for(std::size_t i = 0; i < n * 2; ++i)
+                CHECK(out[i] == Approx(in[i]).margin(1e-6));
+
+        // starts over, primed with silence
+        std::vector<float> again(r.max_output(frames) * 2);
+        CHECK(r.process(in.data(), frames, again.data()) == n - flushed);
+    }
+}
+
+TEST_CASE("ResamplerSimdMatchesScalar") {
+    const std::size_t frames = 2000;
+    const auto in = sine(3000, 44100, frames, 2);
+    resampler scalar{2, 44100, 48000, 16, simd_level::scalar};
+    std::vector<float> expected(scalar.max_output(frames) * 2);
+    const auto n = scalar.process(in.data(), frames, expected.data());
+
+    for(auto level : {simd_level::sse2, simd_level::avx2}) {
+        if(static_cast<int>(level) > static_cast<int>(best_simd_level()))
+            continue;
+        resampler r{2, 44100, 48000, 16, level};
+        std::vector<float> actual(r.max_output(frames) * 2);
+        REQUIRE(r.process(in.data(), frames, actual.data()) == n);
+        for(std::size_t i = 0; i < n * 2; ++i)
+            CHECK(actual[i] == Approx(expected[i]).margin(1e-5));
+    }
+}
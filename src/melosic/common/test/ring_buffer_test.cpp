@@ -0,0 +1,141 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <melosic/common/ring_buffer.hpp>
+using Melosic::spsc_ring_buffer;
+
+TEST_CASE("ring buffer capacity") {
+    spsc_ring_buffer ring{100};
+    CHECK(ring.capacity() == 100u);
+    CHECK(ring.empty());
+    CHECK(ring.write_available() == 100u);
+    CHECK(ring.read_available() == 0u);
+
+    auto regions = ring.prepare(1000);
+    CHECK(asio::buffer_size(regions[0]) == 100u);
+    CHECK(asio::buffer_size(regions[1]) == 0u);
+    CHECK(reinterpret_cast<std::uintptr_t>(asio::buffer_cast<void*>(regions[0])) % Melosic::cache_line_size == 0);
+}
+
+TEST_CASE("ring buffer partial consume") {
+    spsc_ring_buffer ring{16};
+    std::vector<char> in(12);
+    std::iota(in.begin(), in.end(), 0);
+
+    REQUIRE(ring.write(in.data(), in.size()) == 12u);
+    CHECK(ring.size() == 12u);
+
+    ring.consume(5);
+    CHECK(ring.size() == 7u);
+    auto data = ring.data();
+    REQUIRE(asio::buffer_size(data[0]) == 7u);
+    CHECK(asio::buffer_cast<const char*>(data[0])[0] == 5);
+
+    // consuming more than is available is clamped
+    ring.consume(100);
+    CHECK(ring.empty());
+}
+
+TEST_CASE("ring buffer wrap around") {
+    spsc_ring_buffer ring{16};
+    std::vector<char> in(12), out(12);
+    std::iota(in.begin(), in.end(), 0);
+
+    REQUIRE(ring.write(in.data(), in.size()) == 12u);
+    REQUIRE(ring.read(out.data(), 8) == 8u);
+    CHECK(std::equal(out.begin(), out.begin() + 8, in.begin()));
+
+    REQUIRE(ring.write(in.data(), in.size()) == 12u);
+    CHECK(ring.write_available() == 0u);
+    CHECK(ring.write(in.data(), 1) == 0u);
+
+    auto data = ring.data();
+    CHECK(asio::buffer_size(data[0]) == 8u);
+    CHECK(asio::buffer_size(data[1]) == 8u);
+
+    std::vector<char> all(16);
+    REQUIRE(ring.read(all.data(), all.size()) == 16u);
+    CHECK(std::equal(all.begin(), all.begin() + 4, in.begin() + 8));
+    CHECK(std::equal(all.begin() + 4, all.end(), in.begin()));
+}
+
+TEST_CASE("ring buffer rewind") {
+    spsc_ring_buffer ring;
+    ring.reset(16, 4);
+    CHECK(ring.reserve() == 4u);
+    CHECK(ring.write_available() == 12u);
+    std::vector<char> in(12), out(12);
+    std::iota(in.begin(), in.end(), 0);
+
+    REQUIRE(ring.write(in.data(), in.size()) == 12u);
+    CHECK(ring.write_available() == 0u);
+    CHECK(ring.rewind(4) == 0u);
+
+    REQUIRE(ring.read(out.data(), 10) == 10u);
+    REQUIRE(ring.write(in.data(), 12) == 10u);
+    // the reserve still holds the last 4 bytes read
+    CHECK(ring.rewind(8) == 4u);
+    CHECK(ring.size() == 16u);
+    CHECK(ring.write_available() == 0u);
+    REQUIRE(ring.read(out.data(), 6) == 6u);
+    CHECK(std::equal(out.begin(), out.begin() + 6, in.begin() + 6));
+}
+
+TEST_CASE("ring buffer single producer single consumer") {
+    spsc_ring_buffer ring{1021};
+    constexpr auto total = 1u << 20;
+
+    std::thread producer([&] {
+        unsigned char next = 0;
+        for(auto n = 0u; n < total;) {
+            auto regions = ring.prepare(total - n);
+            std::size_t written = 0;
+            for(auto&& region : regions) {
+                auto ptr = asio::buffer_cast<unsigned char*>(region);
+                for(auto i = 0u; i < asio::buffer_size(region); ++i)
+                    ptr[i] = next++;
+                written += asio::buffer_size(region);
+            }
+            ring.commit(written);
+            n += written;
+        }
+    });
+
+    unsigned char expected = 0;
+    bool ok = true;
+    for(auto n = 0u; n < total;) {
+        std::size_t read = 0;
+        for(auto&& region : ring.data()) {
+            auto ptr = asio::buffer_cast<const unsigned char*>(region);
+            for(auto i = 0u; i < asio::buffer_size(region); ++i)
+                ok = ok && ptr[i] == expected++;
+            read += asio::buffer_size(region);
+        }
+        ring.consume(read);
+        n += read;
+    }
+    producer.join();
+
+    CHECK(ok);
+    CHECK(ring.empty());
+}
@@ -0,0 +1,214 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstring>
+
+#include <catch.hpp>
+
+#include <melosic/common/sample_convert.hpp>
+using namespace Melosic;
+
+namespace {
+
+constexpr sample_format all_formats[] = {sample_format::s8,    sample_format::s16, sample_format::s24_3,
+                                         sample_format::s24_4, sample_format::s32, sample_format::f32};
+
+std::vector<char> random_samples(sample_format fmt, std::size_t n) {
+    std::mt19937 gen(42);
+    std::vector<char> buf(n * sample_size(fmt));
+    if(fmt == sample_format::f32) {
+        // exceed full scale to exercise clipping
+        std::uniform_real_distribution<float> dist(-1.2f, 1.2f);
+        for(std::size_t i = 0; i < n; ++i) {
+            const float v = dist(gen);
+            std::memcpy(buf.data() + i * 4, &v, sizeof(v));
+        }
+    } else {
+        std::uniform_int_distribution<int> dist(0, 255);
+        for(auto&& c : buf)
+            c = static_cast<char>(dist(gen));
+    }
+    return buf;
+}
+
+template <typename T> T load(const std::vector<char>& buf, std::size_t i) {
+    T v;
+    std::memcpy(&v, buf.data() + i * sizeof(T), sizeof(T));
+    return v;
+}
+
+} // namespace
+
+TEST_CASE("SampleConvertWiden") {
+    const int16_t in[] = {0, 1, -1, INT16_MAX, INT16_MIN};
+    std::vector<char> out(5 * 4);
+    sample_converter conv{sample_format::s16, sample_format::s32};
+    CHECK(conv.convert(in, 5, out.data()) == out.size());
+
+    CHECK(load<int32_t>(out, 0) == 0);
+    CHECK(load<int32_t>(out, 1) == 1 << 16);
+    CHECK(load<int32_t>(out, 2) == -(1 << 16));
+    CHECK(load<int32_t>(out, 3) == INT16_MAX << 16);
+    CHECK(load<int32_t>(out, 4) == INT32_MIN);
+}
+
+TEST_CASE("SampleConvertNarrow") {
+    const int32_t in[] = {0, 1 << 16, (1 << 15) - 1, 1 << 15, INT32_MAX, INT32_MIN};
+    std::vector<char> out(6 * 2);
+    sample_converter conv{sample_format::s32, sample_format::s16};
+    CHECK(conv.convert(in, 6, out.data()) == out.size());
+
+    CHECK(load<int16_t>(out, 0) == 0);
+    CHECK(load<int16_t>(out, 1) == 1);
+    CHECK(load<int16_t>(out, 2) == 0); // rounds down
+    CHECK(load<int16_t>(out, 3) == 1); // rounds up
+    CHECK(load<int16_t>(out, 4) == INT16_MAX);
+    CHECK(load<int16_t>(out, 5) == INT16_MIN);
+}
+
+TEST_CASE("SampleConvertPacked24") {
+    const unsigned char in[] = {0x01, 0x02, 0x03, 0xff, 0xff, 0xff};
+    std::vector<char> out(2 * 4);
+    sample_converter conv{sample_format::s24_3, sample_format::s24_4};
+    conv.convert(in, 2, out.data());
+
+    CHECK(load<int32_t>(out, 0) == 0x030201);
+    CHECK(load<int32_t>(out, 1) == -1);
+}
+
+TEST_CASE("SampleConvertFloat") {
+    const float in[] = {0.0f, 0.5f, -1.0f, 2.0f};
+    std::vector<char> out(4 * 2);
+    sample_converter conv{sample_format::f32, sample_format::s16};
+    conv.convert(in, 4, out.data());
+
+    CHECK(load<int16_t>(out, 0) == 0);
+    CHECK(load<int16_t>(out, 1) == 1 << 14);
+    CHECK(load<int16_t>(out, 2) == INT16_MIN);
+    CHECK(load<int16_t>(out, 3) == INT16_MAX); // clipped
+}
+
+TEST_CASE("SampleConvertSimdMatchesScalar") {
+    // odd length to cover the scalar tails and more than one pivot block
+    constexpr std::size_t n = 1031;
+    for(auto level : {simd_level::sse2, simd_level::avx2}) {
+        if(static_cast<int>(level) > static_cast<int>(best_simd_level()))
+            continue;
+        for(auto from : all_formats) {
+            const auto in = random_samples(from, n);
+            for(auto to : all_formats) {
+                for(auto d : {dither::none, dither::tpdf}) {
+                    std::vector<char> expected(n * sample_size(to)), actual(n * sample_size(to));
+                    sample_converter{from, to, d, simd_level::scalar}.convert(in.data(), n, expected.data());
+                    sample_converter{from, to, d, level}.convert(in.data(), n, actual.data());
+                    INFO("level " << static_cast<int>(level) << "; from " << static_cast<int>(from) << "; to "
+                                  << static_cast<int>(to) << "; dither " << static_cast<int>(d));
+                    CHECK(expected == actual);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("SampleConvertDither") {
+    constexpr std::size_t n = 4096;
+    std::vector<int32_t> in(n, 123 << 16);
+    std::vector<int16_t> out(n);
+    sample_converter conv{sample_format::s32, sample_format::s16, dither::tpdf};
+    conv.convert(in.data(), n, out.data());
+
+    bool varied = false;
+    for(auto&& s : out) {
+        // TPDF dither is at most 1 LSB either way
+        CHECK(s >= 122);
+        CHECK(s <= 124);
+        varied |= s != 123;
+    }
+    CHECK(varied);
+}
+
+TEST_CASE("SampleConvertIntToFloat") {
+    std::mt19937 gen(7);
+    for(unsigned bits : {8u, 16u, 24u, 32u}) {
+        const int64_t max = (int64_t(1) << (bits - 1)) - 1;
+        std::uniform_int_distribution<int64_t> dist(-max - 1, max);
+        std::vector<int32_t> in(1003);
+        for(auto&& v : in)
+            v = static_cast<int32_t>(dist(gen));
+        in[0] = static_cast<int32_t>(-max - 1);
+
+        // same result as going through sample_converter from the left-justified format
+        std::vector<int32_t> justified(in.size());
+        for(std::size_t i = 0; i < in.size(); ++i)
+            justified[i] = static_cast<int32_t>(static_cast<uint32_t>(in[i]) << (32 - bits));
+        std::vector<float> expected(in.size());
+        sample_converter{sample_format::s32, sample_format::f32, dither::none, simd_level::scalar}.convert(
+            justified.data(), in.size(), expected.data());
+        CHECK(expected[0] == -1.0f);
+
+        for(auto level : {simd_level::scalar, simd_level::sse2, simd_level::avx2}) {
+            if(static_cast<int>(level) > static_cast<int>(best_simd_level()))
+                continue;
+            std::vector<float> out(in.size());
+            int_to_float(in.data(), in.size(), bits, out.data(), level);
+            CHECK(out == expected);
+        }
+    }
+}
+
+TEST_CASE("SampleConvertIntToPacked") {
+    std::mt19937 gen(11);
+    for(unsigned bytes : {1u, 2u, 3u, 4u}) {
+        const int64_t max = (int64_t(1) << (bytes * 8 - 1)) - 1;
+        std::uniform_int_distribution<int64_t> dist(-max - 1, max);
+        // odd length to cover the scalar tails
+        std::vector<int32_t> in(1027);
+        for(auto&& v : in)
+            v = static_cast<int32_t>(dist(gen));
+        in[0] = static_cast<int32_t>(-max - 1);
+        in[1] = static_cast<int32_t>(max);
+
+        std::vector<char> expected(in.size() * bytes);
+        for(std::size_t i = 0; i < in.size(); ++i)
+            std::memcpy(expected.data() + i * bytes, &in[i], bytes);
+
+        for(auto level : {simd_level::scalar, simd_level::sse2, simd_level::avx2}) {
+            if(static_cast<int>(level) > static_cast<int>(best_simd_level()))
+                continue;
+            const auto pack = select_int_packer(bytes, level);
+            REQUIRE(pack != nullptr);
+            for(auto n : {in.size(), std::size_t(12), std::size_t(7)}) {
+                // guard bytes catch overlong stores
+                std::vector<char> out(n * bytes + 16, 0x55);
+                pack(in.data(), n, out.data());
+                INFO("bytes " << bytes << "; level " << static_cast<int>(level) << "; n " << n);
+                CHECK(std::equal(out.begin(), out.begin() + n * bytes, expected.begin()));
+                CHECK(std::all_of(out.begin() + n * bytes, out.end(), [](char c) { return c == 0x55; }));
+
+                std::vector<int32_t> back(n);
+                select_int_unpacker(bytes, level)(out.data(), n, back.data());
+                CHECK(std::equal(back.begin(), back.end(), in.begin()));
+            }
+        }
+    }
+    CHECK(select_int_packer(5) == nullptr);
+    CHECK(select_int_unpacker(5) == nullptr);
+}
@@ -0,0 +1,66 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <catch.hpp>
+
+#include <melosic/common/seek_index.hpp>
+using namespace Melosic;
+
+TEST_CASE("SeekIndexSpacing") {
+    seek_index idx{1000};
+    CHECK(idx.empty());
+    CHECK(idx.add({0, 100}));
+    CHECK(!idx.add({999, 200}));
+    CHECK(idx.add({1000, 300}));
+    // out of order, as after a seek
+    CHECK(idx.add({5000, 900}));
+    CHECK(!idx.add({4500, 800}));
+    CHECK(idx.add({3000, 700}));
+    CHECK(!idx.add({3000, 700}));
+
+    REQUIRE(idx.size() == 4u);
+    CHECK(idx.points()[0] == (seek_point{0, 100}));
+    CHECK(idx.points()[1] == (seek_point{1000, 300}));
+    CHECK(idx.points()[2] == (seek_point{3000, 700}));
+    CHECK(idx.points()[3] == (seek_point{5000, 900}));
+}
+
+TEST_CASE("SeekIndexFind") {
+    seek_index idx{1000, {{4000, 40}, {0, 1}, {1000, 10}}};
+    CHECK(idx.points().front().sample == 0u);
+
+    auto p = idx.find(0);
+    REQUIRE(p);
+    CHECK(p->offset == 1u);
+
+    p = idx.find(1500);
+    REQUIRE(p);
+    CHECK(p->offset == 10u);
+
+    p = idx.find(3000);
+    REQUIRE(p);
+    CHECK(p->offset == 10u);
+
+    // too far past the last point before it
+    CHECK(!idx.find(3001));
+
+    p = idx.find(4001);
+    REQUIRE(p);
+    CHECK(p->offset == 40u);
+
+    CHECK(!seek_index{1000}.find(0));
+}
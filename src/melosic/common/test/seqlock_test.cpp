@@ -0,0 +1,71 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <melosic/common/seqlock.hpp>
+using Melosic::seqlock;
+
+namespace {
+
+struct values {
+    int64_t a;
+    int64_t b;
+    int32_t c;
+};
+
+} // namespace
+
+TEST_CASE("SeqlockStoreLoad") {
+    seqlock<values> s;
+    CHECK(s.load().a == 0);
+
+    s.store({1, 2, 3});
+    const auto v = s.load();
+    CHECK(v.a == 1);
+    CHECK(v.b == 2);
+    CHECK(v.c == 3);
+}
+
+TEST_CASE("SeqlockReadersSeeWholeValues") {
+    seqlock<values> s{{0, 0, 0}};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    std::atomic<int> torn{0};
+    for(int i = 0; i < 2; ++i)
+        readers.emplace_back([&] {
+            while(!done.load()) {
+                const auto v = s.load();
+                if(v.b != -v.a || v.c != static_cast<int32_t>(v.a))
+                    ++torn;
+            }
+        });
+
+    for(int64_t i = 1; i <= 200000; ++i)
+        s.store({i, -i, static_cast<int32_t>(i)});
+    done = true;
+    for(auto&& t : readers)
+        t.join();
+
+    CHECK(torn == 0);
+    CHECK(s.load().a == 200000);
+}
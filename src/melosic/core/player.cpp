@@ -17,12 +17,14 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 namespace this_thread = std::this_thread;
 using std::mutex;
 using unique_lock = std::unique_lock<mutex>;
 using lock_guard = std::lock_guard<mutex>;
 #include <atomic>
 #include <functional>
+#include <deque>
 
 #include <boost/iostreams/read.hpp>
 #include <boost/iostreams/compose.hpp>
@@ -48,8 +50,15 @@ namespace io = boost::iostreams;
 #include <melosic/melin/config.hpp>
 #include <melosic/common/int_get.hpp>
 #include <melosic/common/pcmbuffer.hpp>
+#include <melosic/common/ring_buffer.hpp>
+#include <melosic/common/sample_convert.hpp>
+#include <melosic/common/mix.hpp>
+#include <melosic/common/resampler.hpp>
 #include <melosic/common/optional.hpp>
+#include <melosic/common/play_timeline.hpp>
+#include <melosic/common/seqlock.hpp>
 #include <melosic/melin/decoder.hpp>
+#include <melosic/melin/dsp.hpp>
 
 #include "player.hpp"
 
@@ -66,20 +75,44 @@ struct StateChanged : Signals::Signal<Signals::Player::StateChanged> {
     using Super::Signal;
 };
 
+struct TrackChanged : Signals::Signal<Signals::Player::TrackChanged> {
+    using Super::Signal;
+};
+
 struct State;
 
+// releases a held lock for the lifetime of the guard
+struct unlock_guard {
+    // records how long retaking the lock takes in wait, if given
+    explicit unlock_guard(unique_lock& l, histogram* wait = nullptr) : l(l), wait(wait) {
+        l.unlock();
+    }
+    ~unlock_guard() {
+        if(!wait) {
+            l.lock();
+            return;
+        }
+        const auto start = chrono::steady_clock::now();
+        l.lock();
+        wait->record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+    }
+    unique_lock& l;
+    histogram* wait;
+};
+
 struct Player::impl : std::enable_shared_from_this<Player::impl> {
     explicit impl(Core::Kernel& kernel);
 
     ~impl();
 
     void play() {
-        unique_lock l(mu);
-        play_impl();
-        if(state_impl() == DeviceState::Playing) {
-            l.unlock();
-            write_handler(std::error_code(), 0);
-        }
+        lock_guard l(mu);
+        request([this] {
+            m_decode_eof = false;
+            play_impl();
+            if(state_impl() == DeviceState::Playing)
+                start_writing();
+        });
     }
     void play_impl();
 
@@ -90,49 +123,121 @@ struct Player::impl : std::enable_shared_from_this<Player::impl> {
     void pause_impl();
 
     void stop() {
-        unique_lock l(mu);
-        stop_impl();
-        for(auto& buf : in_buf)
-            ::operator delete(asio::buffer_cast<void*>(buf));
-        in_buf.clear();
+        lock_guard l(mu);
+        request([this] {
+            stop_impl();
+            m_ring.clear();
+        });
     }
     void stop_impl();
 
     void seek(chrono::milliseconds dur);
-
-    chrono::milliseconds tell() {
-        unique_lock l(mu);
-        return tell_impl();
+    // drops everything decoded but not yet heard: the device's queue, m_ring and the processing state between,
+    // so what's heard next is what's decoded next. not while m_current_source is being decoded
+    void flush_output();
+    // after flush_output(); reports pos of the current track until what's decoded next is heard
+    void hold_timeline_at(chrono::milliseconds pos);
+
+    // the audible position; lock-free
+    chrono::milliseconds tell() const {
+        const auto heard = m_audible.load();
+        if(!heard.valid)
+            return 0ms;
+        auto pos = chrono::microseconds(heard.pos);
+        if(heard.running) {
+            const auto since = chrono::steady_clock::now() - chrono::steady_clock::time_point(
+                                                                  chrono::steady_clock::duration(heard.at));
+            pos = std::min(pos + chrono::duration_cast<chrono::microseconds>(since), chrono::microseconds(heard.until));
+        }
+        return chrono::duration_cast<chrono::milliseconds>(pos);
     }
     chrono::milliseconds tell_impl();
 
-    Output::DeviceState state() {
-        unique_lock l(mu);
-        return state_impl();
+    // lock-free
+    Output::DeviceState state() const {
+        return m_state.load(std::memory_order_acquire);
     }
     Output::DeviceState state_impl();
 
     void next() {
-        unique_lock l(mu);
-        next_impl();
+        lock_guard l(mu);
+        request([this] {
+            next_impl();
+            track_requested();
+        });
     }
     void next_impl();
 
     void previous() {
-        unique_lock l(mu);
-        previous_impl();
+        lock_guard l(mu);
+        request([this] {
+            previous_impl();
+            track_requested();
+        });
     }
     void previous_impl();
 
     void jumpTo(int p) {
-        unique_lock l(mu);
-        jumpTo_impl(p);
+        lock_guard l(mu);
+        request([this, p] {
+            jumpTo_impl(p);
+            track_requested();
+        });
     }
     void jumpTo_impl(int);
+    // after a control call moves m_current_iterator; what's left of the old track is dropped rather than played out
+    void track_requested();
+
+    // control calls changing what's decoded go through here. they're run straight away unless m_current_source is
+    // being decoded or the track and output opened or prepared, otherwise by the decode thread once it's done, so
+    // callers needn't wait on any of them. mu must be held
+    void request(std::function<void()> f) {
+        m_control_generation.fetch_add(1, std::memory_order_relaxed);
+        run_or_defer(std::move(f));
+    }
+    // as request(), for what isn't a control call, so doesn't overtake what was scheduled before it
+    void run_or_defer(std::function<void()> f) {
+        if(m_requests.empty() && !busy())
+            f();
+        else
+            m_requests.push_back(std::move(f));
+        m_decode_cv.notify_all();
+    }
+    // for completions on the audio thread, which mustn't hold writes; it runs the write completions they wait on.
+    // always run by the decode thread, first if it completes what's being waited on. mu must be held
+    void defer_to_decoder(std::function<void()> f, bool first = false) {
+        if(first)
+            m_requests.push_front(std::move(f));
+        else
+            m_requests.push_back(std::move(f));
+        m_decode_cv.notify_all();
+    }
+    void run_requests() {
+        while(!m_requests.empty() && !busy()) {
+            auto f = std::move(m_requests.front());
+            m_requests.pop_front();
+            f();
+        }
+    }
+    bool busy() const {
+        return m_decoding || m_opening || m_preparing;
+    }
+    std::deque<std::function<void()>> m_requests; // guarded by mu
+    // bumped by every control call, so what was scheduled before one can tell it's been overtaken
+    std::atomic<uint64_t> m_control_generation{0};
 
     void currentPlaylistChangedSlot(optional<Playlist>);
     void trackChangeSlot(int, optional<Track>);
     void changeDevice();
+    // for when swap_output() can't; stops, then plays on the current sink from what was last heard, paused if asked
+    void restart_output(bool paused);
+    // moves to the current sink without stopping, carrying over m_ring and what the old device had yet to play.
+    // the new device is prepared in the background while the old one plays on; see output_swap_prepared()
+    void swap_output();
+    // swaps in next if it took the specs the old device has, otherwise falls back to restart_output()
+    void output_swap_prepared(std::error_code ec, AudioSpecs prepared,
+                              std::unique_ptr<AudioIO::AudioOutputBase> next, std::string name);
+    uint64_t m_sink_generation{0}; // bumped by each sink change and stop, so a swap in progress is dropped; mu
     void sinkChangeSlot();
 
     Core::Kernel& kernel;
@@ -140,15 +245,21 @@ struct Player::impl : std::enable_shared_from_this<Player::impl> {
     std::shared_ptr<Output::Manager> outman;
     std::shared_ptr<Config::Manager> confman;
     std::shared_ptr<Decoder::Manager> decman;
+    std::shared_ptr<DSP::Manager> dspman;
 
     mutex mu;
 
+    // snapshots of the shared state for lock-free reads by control calls
+    std::atomic<Output::DeviceState> m_state{Output::DeviceState::Stopped};
+    std::shared_ptr<const optional<Playlist>> m_playlist_snapshot; // via std::atomic_load/atomic_store
+
     StateChanged stateChanged;
 
     std::shared_ptr<State> m_current_state;
     friend struct State;
 
     NotifyPlayPos notifyPlayPosition;
+    TrackChanged trackChanged;
     Logger::Logger logject{logging::keywords::channel = "Player"};
     friend class Player;
 
@@ -161,21 +272,189 @@ struct Player::impl : std::enable_shared_from_this<Player::impl> {
     }
 
     std::unique_ptr<AudioIO::AudioOutputBase> asioOutput;
-
-    std::list<PCMBuffer> in_buf;
-
+    std::string m_sink_name; // of asioOutput
+
+    // decoded audio, in the output's format, waiting to be written to the output
+    spsc_ring_buffer m_ring;
+    // decoder output when it must be converted before entering m_ring; only grows
+    std::vector<char> m_decode_buf;
+    sample_converter m_converter;
+
+    // producer; runs on m_decode_thread keeping m_ring filled m_decode_ahead ahead of the output
+    void decode_loop();
+    void decode_ahead(unique_lock&);
+    // returns frames committed to m_ring
+    size_t decode_to_ring(AudioSpecs as, AudioSpecs out_as, size_t frames, std::error_code& ec);
+    void preload_next(unique_lock&);
+    void begin_crossfade(AudioSpecs out_as);
+    size_t crossfade_to_ring(AudioSpecs as, AudioSpecs out_as, size_t frames, std::error_code& ec);
+    size_t resample_to_ring(AudioSpecs as, AudioSpecs out_as, size_t frames, std::error_code& ec);
+    void commit_float(float* in, size_t samples, AudioSpecs out_as);
+    // float to the output's format, for commit_float(); kept so its dither runs on rather than restarting each block
+    sample_converter m_float_converter;
+    bool m_float_dither{false}; // m_dither when m_float_converter was made
+
+    // processing between decoding and the output ring; used without mu only while m_decoding
+    DSP::chain m_dsp;
+    // configured chain, picked up by the decode thread; guarded by mu
+    std::vector<std::string> m_dsp_names;
+    bool m_dsp_changed{false};
+    std::vector<float> m_dsp_buf; // only grows
+    void update_dsp(AudioSpecs out_as);
+    void run_dsp(float* samples, size_t frames, unsigned channels) noexcept;
+    // at the end of the playlist, runs silence through m_dsp until its tail, eg. reverb, is in m_ring.
+    // false while m_ring is too full to take the rest
+    bool drain_dsp(unique_lock&);
+    optional<size_t> m_dsp_tail; // frames of it still to come; decode thread
+    size_t decode_float_to_ring(AudioSpecs as, AudioSpecs out_as, size_t frames, std::error_code& ec);
+
+    // converts sources whose sample rate differs from the output's, when m_resample is set
+    std::unique_ptr<resampler> m_resampler;
+    std::vector<float> m_resample_in, m_resample_out; // only grow
+
+    // overlap of m_current_source fading out and m_next_source fading in
+    struct crossfade {
+        size_t pos = 0;
+        size_t frames = 0; // 0 when not fading
+        // scratch; only grows
+        std::vector<float> out, in, gain_out, gain_in;
+    } m_fade;
+    // what a run of output frames was decoded from
+    struct timeline_source {
+        uint64_t generation; // m_track_generation; changes with the track
+        optional<Track> track;
+        chrono::milliseconds duration;
+    };
+    // maps output frames back to their track and position, so what's reported is what's audible
+    mutable mutex m_timeline_mu;
+    play_timeline<timeline_source> m_timeline; // guarded by m_timeline_mu
+    optional<uint64_t> m_audible_generation;   // write completions
+    // published from m_timeline on every change, for tell() and currentTrack() to read lock-free
+    struct audible_estimate {
+        bool valid;
+        bool running;
+        int64_t pos, until; // microseconds
+        chrono::steady_clock::rep at;
+    };
+    seqlock<audible_estimate> m_audible;
+    std::shared_ptr<const optional<Track>> m_audible_track; // via std::atomic_load/atomic_store
+    optional<uint64_t> m_published_generation;             // of m_audible_track; guarded by m_timeline_mu
+    // m_timeline_mu must be held
+    void publish_timeline(chrono::steady_clock::time_point now);
+    // records frames just committed to m_ring from m_current_source
+    void commit_timeline(size_t frames, AudioSpecs out_as);
+    // updates the timeline after the output took frames, signalling any change in what's audible
+    void written_timeline(size_t frames);
+    void pause_timeline(bool paused);
+    // Stopped::play()'s slow part, done on the decode thread without mu: opening the current track and the output
+    void open_for_play(unique_lock&);
+    bool m_open_pending{false};                // guarded by mu
+    bool m_opening{false};                     // while open_for_play() is without mu; guarded by mu
+    optional<chrono::milliseconds> m_open_at; // where to start the track opened; guarded by mu
+    // prepares the output for as in the background, entering Preparing meanwhile
+    void async_prepare_output(AudioSpecs as);
+    // sizes m_ring to suit the prepared output and moves on to Playing, or Paused if asked while preparing.
+    // mu must be held
+    void output_prepared(std::error_code ec, AudioSpecs out_as);
+    // guarded by mu
+    bool m_preparing{false};
+    bool m_pause_when_prepared{false};
+    bool low_power_output() const;
+    chrono::milliseconds output_latency() const;
+
+    // lock-free; recorded from the decode thread and write completions
+    struct stats {
+        histogram decode_time, lock_wait, buffer_fill, write_size, track_change, decode_interval;
+        std::atomic<uint64_t> decoder_underruns{0};
+        std::atomic<uint64_t> decode_wakeups{0};
+        std::atomic<uint64_t> output_wakeups{0};
+        // of every device played to since
+        std::atomic<uint64_t> device_xruns{0};
+        std::atomic<uint64_t> device_recoveries{0};
+        std::atomic<chrono::steady_clock::rep> since{chrono::steady_clock::now().time_since_epoch().count()};
+    } m_stats;
+    chrono::steady_clock::time_point m_last_decode{}; // decode thread
+    // adds asioOutput's device events since last counted to m_stats. with mu, or on write completions
+    void count_device_events();
+    AudioIO::output_stats m_device_counted; // of asioOutput
+    // guarded by mu; set when the track changes until the new track's first frame is decoded
+    chrono::steady_clock::time_point m_track_change_start{};
+    void track_changed() {
+        if(m_track_change_start == chrono::steady_clock::time_point{})
+            m_track_change_start = chrono::steady_clock::now();
+    }
+    size_t timed_decode(Decoder::PCMSource& source, PCMBuffer& buf, std::error_code& ec) {
+        const auto start = chrono::steady_clock::now();
+        const auto n = source.decode(buf, ec);
+        m_stats.decode_time.record(
+            chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+        return n;
+    }
+    size_t timed_decode_float(Decoder::PCMSource& source, float* out, size_t frames, std::error_code& ec) {
+        const auto start = chrono::steady_clock::now();
+        const auto n = source.decode_float(out, frames, ec);
+        m_stats.decode_time.record(
+            chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+        return n;
+    }
+    // consumer; only ever hands already decoded audio to the output
+    void start_writing();
+    void async_write_ring();
     void write_handler(std::error_code ec, std::size_t n);
-    void read_handler(std::error_code ec, std::size_t n);
+    // cancels the write in flight, if any, and waits for it to complete; until destroyed none are started, so
+    // asioOutput and m_ring may be changed. writing resumes with start_writing()
+    struct writes_held {
+        explicit writes_held(impl& p) : p(p) {
+            p.m_writes_held = true;
+            std::error_code ec;
+            // nothing is written to an output being prepared
+            if(p.asioOutput && !p.m_preparing)
+                p.asioOutput->cancel(ec);
+            while(p.m_writing.load())
+                this_thread::yield();
+        }
+        ~writes_held() {
+            p.m_writes_held = false;
+        }
+        impl& p;
+    };
 
     optional<Playlist> m_current_playlist;
     std::vector<Signals::ScopedConnection> m_signal_connections;
     std::unique_ptr<Decoder::PCMSource> m_current_source;
     std::unique_ptr<Decoder::PCMSource> m_next_source;
     Playlist::iterator m_current_iterator;
-    chrono::milliseconds m_gapless_preload{1000};
+    // bumped whenever m_current_iterator moves, so work done without mu can detect it is stale
+    uint64_t m_track_generation{0};
+    // config; set from the config thread, read without locking
+    std::atomic<chrono::milliseconds> m_gapless_preload{1000ms};
+    std::atomic<chrono::milliseconds> m_crossfade{0ms};
+    // on a sample rate change, resample rather than re-prepare the device
+    std::atomic<bool> m_resample{false};
 
     Config::Conf conf{"Player"};
-    chrono::milliseconds buffer_time{1000};
+    std::atomic<chrono::milliseconds> buffer_time{1000ms};
+    // device latency target; see Output conf "latency"
+    std::atomic<int64_t> m_latency_ms{200};
+    // outputs that buffer for longer and decode in bursts, so the CPU can stay idle in between
+    std::vector<std::string> m_low_power_outputs; // guarded by mu
+    std::atomic<int64_t> m_low_power_latency_ms{2000};
+    // free space in m_ring worth waking the decoder for; set with the ring
+    std::atomic<size_t> m_decode_chunk{0};
+    // least time between NotifyPlayPos signals
+    std::atomic<chrono::milliseconds> m_position_interval{250ms};
+    chrono::steady_clock::time_point m_last_position{}; // write completions
+    std::atomic<chrono::milliseconds> m_decode_ahead{2000ms};
+    std::atomic<bool> m_dither{true};
+
+    std::condition_variable m_decode_cv;
+    bool m_decode_thread_stop{false};
+    bool m_decoding{false};
+    // no more tracks to decode; output stops once m_ring drains
+    std::atomic<bool> m_decode_eof{false};
+    std::atomic<bool> m_writing{false};
+    std::atomic<bool> m_writes_held{false};
+    std::thread m_decode_thread;
 
     void loadedSlot(boost::synchronized_value<Config::Conf>& base) {
         TRACE_LOG(logject) << "Player conf loaded";
@@ -206,8 +485,36 @@ struct Player::impl : std::enable_shared_from_this<Player::impl> {
         try {
             if(key == "buffer time")
                 buffer_time = chrono::milliseconds(get<int64_t>(val));
+            else if(key == "latency")
+                m_latency_ms = get<int64_t>(val);
+            else if(key == "low power latency")
+                m_low_power_latency_ms = get<int64_t>(val);
+            else if(key == "low power outputs") {
+                std::vector<std::string> names;
+                for(auto& name : get<std::vector<Config::VarType>>(val))
+                    names.emplace_back(get<std::string>(name));
+                lock_guard l(mu);
+                m_low_power_outputs = std::move(names);
+            } else if(key == "position interval")
+                m_position_interval = chrono::milliseconds(get<int64_t>(val));
             else if(key == "gapless preload time")
                 m_gapless_preload = chrono::milliseconds(get<int64_t>(val));
+            else if(key == "crossfade time")
+                m_crossfade = chrono::milliseconds(get<int64_t>(val));
+            else if(key == "sample rate change")
+                m_resample = get<std::string>(val) == "resample";
+            else if(key == "dsp chain") {
+                std::vector<std::string> names;
+                for(auto& name : get<std::vector<Config::VarType>>(val))
+                    names.emplace_back(get<std::string>(name));
+                lock_guard l(mu);
+                m_dsp_names = std::move(names);
+                m_dsp_changed = true;
+            }
+            else if(key == "decode ahead time")
+                m_decode_ahead = chrono::milliseconds(get<int64_t>(val));
+            else if(key == "dither")
+                m_dither = get<bool>(val);
         } catch(boost::bad_get&) {
             ERROR_LOG(logject) << "Config: Couldn't get variable for key: " << key;
         }
@@ -221,48 +528,17 @@ struct Player::impl : std::enable_shared_from_this<Player::impl> {
     }
 };
 
-static PCMBuffer widen(PCMBuffer in, const size_t n, const uint8_t bps_to) noexcept {
-    assert(in.audio_specs.bps);
-    assert(bps_to);
-    assert(!(bps_to % 8));
-    assert(!(in.audio_specs.bps % 8));
-    assert(in.audio_specs.bps != bps_to);
-
-    auto from = in.audio_specs.bps / 8;
-    auto to = bps_to / 8;
-    assert(!(n % from));
-
-    PCMBuffer out{::operator new((n / from) * to), (n / from) * to};
-    assert(asio::buffer_size(out) == (n / from) * to);
-
-    auto out_ptr = asio::buffer_cast<char*>(out);
-
-    auto in_ptr = asio::buffer_cast<const char*>(in);
-    if(to > from) {
-        for(auto i = 0u; i < n; i += from) {
-            auto old_ptr = out_ptr;
-            out_ptr = std::fill_n(out_ptr, to - from, 0);
-            out_ptr = std::copy_n(std::next(in_ptr, i), from, out_ptr);
-            assert(std::distance(old_ptr, out_ptr) == to);
-        }
-        assert(std::distance(asio::buffer_cast<char*>(out), out_ptr) == static_cast<ptrdiff_t>((n / from) * to));
-    } else if(to < from) {
-        assert(false);
-        std::abort();
-        for(auto i = 0u; i < n; i += from) {
-            out_ptr = std::copy(in_ptr + i, in_ptr + i + to, out_ptr);
-        }
-    } else
-        assert(false);
-
-    return out;
-}
-
 struct State {
   protected:
     explicit State(StateChanged& stateChanged) : stateChanged(stateChanged) {
     }
 
+    // publish for lock-free Player::state() before notifying
+    void changed(Output::DeviceState state) {
+        stateMachine->m_state.store(state, std::memory_order_release);
+        stateChanged(state);
+    }
+
   public:
     virtual ~State() {
     }
@@ -292,201 +568,651 @@ struct State {
 decltype(State::stateMachine) State::stateMachine(nullptr);
 decltype(State::playman) State::playman(nullptr);
 
-void Player::impl::write_handler(std::error_code ec, std::size_t n) {
+void Player::impl::decode_loop() {
     unique_lock l(mu);
-    if(state_impl() != Output::DeviceState::Playing)
+    while(true) {
+        m_decode_cv.wait(l, [this] {
+            if(m_decode_thread_stop)
+                return true;
+            if(m_preparing)
+                return false;
+            if(!m_requests.empty() || m_open_pending)
+                return true;
+            if(state_impl() != Output::DeviceState::Playing || m_decode_eof)
+                return false;
+            return m_ring.write_available() >= m_decode_chunk.load(std::memory_order_relaxed);
+        });
+        if(m_decode_thread_stop)
+            return;
+        m_stats.decode_wakeups.fetch_add(1, std::memory_order_relaxed);
+        run_requests();
+        if(m_open_pending) {
+            open_for_play(l);
+            continue;
+        }
+        if(state_impl() != Output::DeviceState::Playing || m_decode_eof ||
+           m_ring.write_available() < m_decode_chunk.load(std::memory_order_relaxed))
+            continue;
+
+        const auto now = chrono::steady_clock::now();
+        if(m_last_decode != chrono::steady_clock::time_point{})
+            m_stats.decode_interval.record(chrono::duration_cast<chrono::microseconds>(now - m_last_decode).count());
+        m_last_decode = now;
+
+        decode_ahead(l);
+        if(state_impl() == Output::DeviceState::Playing)
+            start_writing();
+    }
+}
+
+void Player::impl::decode_ahead(unique_lock& l) {
+    if(!m_current_playlist || m_current_iterator == m_current_playlist->end()) {
+        if(!drain_dsp(l))
+            return;
+        TRACE_LOG(logject) << "no current track; stopping once output drains";
+        m_decode_eof = true;
+        start_writing();
         return;
+    }
+    try {
+        if(!m_current_source) {
+            if(m_next_source) // get pre-loaded source if available
+                m_current_source = std::move(m_next_source);
+            else { // otherwise open new source from playlist item. throws on error
+                const Track track = *m_current_iterator;
+                const auto generation = m_track_generation;
+                std::unique_ptr<Decoder::PCMSource> source;
+                {
+                    unlock_guard u(l);
+                    source = decman->open(track);
+                }
+                // the current track was changed while opening; start again
+                if(generation != m_track_generation || m_current_source)
+                    return;
+                m_current_source = std::move(source);
+            }
+        }
+        auto as = m_current_source->getAudioSpecs();
+        const auto out_as = asioOutput->current_specs();
+
+        if(as != out_as) {
+            auto new_as = as;
+            new_as.bps = out_as.bps;
+            if(m_resample.load())
+                new_as.sample_rate = out_as.sample_rate;
+            if(new_as != out_as) {
+                // let the previous track play out before the device is re-prepared. what's deferred to this thread
+                // is run meanwhile
+                m_decode_cv.wait(l, [this] {
+                    return m_decode_thread_stop || m_ring.empty() || !m_requests.empty() ||
+                           state_impl() != Output::DeviceState::Playing;
+                });
+                if(m_decode_thread_stop || !m_requests.empty() || state_impl() != Output::DeviceState::Playing)
+                    return;
+                // stop + play to force device to re-prepare
+                TRACE_LOG(logject) << "AudioSpecs mismatch";
+                {
+                    writes_held held{*this};
+                    m_current_state->stop();
+                }
+                m_current_state->play();
+                return;
+            }
+        }
 
-    if(m_current_source) {
-        notifyPlayPosition(m_current_source->tell(), m_current_source->duration());
-        if(m_current_playlist && m_current_source->duration() - m_current_source->tell() < m_gapless_preload) {
-            auto nt = m_current_iterator + 1;
-            if(nt != m_current_playlist->end() && !m_next_source) {
-                assert(nt != m_current_iterator);
-                TRACE_LOG(logject) << "Pre-loading next track in list";
-                m_next_source = decman->open(*nt);
-                assert(m_next_source);
+        update_dsp(out_as);
+
+        // fill a whole chunk, continuing into the next track when this one ends part way through
+        const auto frames_wanted = out_as.bytes_to_samples(m_decode_chunk.load(std::memory_order_relaxed));
+        size_t frames_decoded = 0;
+        while(frames_decoded < frames_wanted) {
+            if(!m_fade.frames)
+                begin_crossfade(out_as);
+            const bool fading = m_fade.frames > 0;
+            size_t n = 0;
+            std::error_code ec;
+            m_decoding = true;
+            try {
+                unlock_guard u(l, &m_stats.lock_wait);
+                const auto frames = frames_wanted - frames_decoded;
+                if(fading)
+                    n = crossfade_to_ring(as, out_as, frames, ec);
+                else if(as.sample_rate != out_as.sample_rate)
+                    n = resample_to_ring(as, out_as, frames, ec);
+                else
+                    n = decode_to_ring(as, out_as, frames, ec);
+            } catch(...) {
+                m_decoding = false;
+                m_decode_cv.notify_all();
+                throw;
+            }
+            m_decoding = false;
+            m_decode_cv.notify_all();
+            frames_decoded += n;
+            TRACE_LOG(logject) << "decoded " << n << " frames of PCM; " << as;
+            if(n > 0 && m_track_change_start != chrono::steady_clock::time_point{}) {
+                m_stats.track_change.record(chrono::duration_cast<chrono::microseconds>(
+                                                chrono::steady_clock::now() - m_track_change_start).count());
+                m_track_change_start = {};
             }
+
+            commit_timeline(n, out_as);
+            if(ec && ec != asio::error::eof)
+                ERROR_LOG(logject) << "Couldn't decode track; skipping the rest: " << ec.message();
+            // a control call is waiting, and likely to drop what was just decoded
+            if(!m_requests.empty())
+                return;
+            const auto generation = m_track_generation;
+            preload_next(l);
+            if(generation != m_track_generation)
+                return;
+
+            if(fading) {
+                if(m_fade.pos < m_fade.frames) {
+                    if(n == 0)
+                        break;
+                    continue;
+                }
+                TRACE_LOG(logject) << "crossfade complete";
+            } else if(!ec && m_current_source->valid())
+                break;
+            TRACE_LOG(logject) << "track ended, starting next, if any";
+            next_impl();
+            if(!m_current_source)
+                break; // not pre-loaded; opened on the next pass
+            as = m_current_source->getAudioSpecs();
+            if(as.channels != out_as.channels || (as.sample_rate != out_as.sample_rate && !m_resample.load()))
+                break; // device must be re-prepared first
+            TRACE_LOG(logject) << "splicing next track at frame " << frames_decoded << " of " << frames_wanted;
         }
+    } catch(...) {
+        ERROR_LOG(logject) << boost::current_exception_diagnostic_information();
+        stop_impl();
+        next_impl();
+        if(m_current_iterator != m_current_playlist->end())
+            play_impl();
     }
+}
+
+void Player::impl::preload_next(unique_lock& l) {
+    if(!m_current_playlist || !m_current_source || m_next_source ||
+       m_current_source->duration() - m_current_source->tell() >=
+           std::max(m_gapless_preload.load(), m_crossfade.load() + buffer_time.load()))
+        return;
+    auto nt = m_current_iterator + 1;
+    if(nt == m_current_playlist->end())
+        return;
+    assert(nt != m_current_iterator);
+    TRACE_LOG(logject) << "Pre-loading next track in list";
+    const Track track = *nt;
+    const auto generation = m_track_generation;
+    std::unique_ptr<Decoder::PCMSource> source;
+    {
+        unlock_guard u(l);
+        source = decman->open(track);
+    }
+    assert(source);
+    if(generation == m_track_generation && !m_next_source)
+        m_next_source = std::move(source);
+}
+
+void Player::impl::begin_crossfade(const AudioSpecs out_as) {
+    const auto crossfade = m_crossfade.load();
+    if(crossfade <= 0ms || !m_next_source || m_current_source->getAudioSpecs().sample_rate != out_as.sample_rate)
+        return;
+    const auto remaining = m_current_source->duration() - m_current_source->tell();
+    if(remaining > crossfade)
+        return;
+    // the device can't play both at once; fall back to gapless
+    const auto next_as = m_next_source->getAudioSpecs();
+    if(next_as.channels != out_as.channels || next_as.sample_rate != out_as.sample_rate)
+        return;
+    m_fade.pos = 0;
+    m_fade.frames = out_as.time_to_samples(remaining);
+    TRACE_LOG(logject) << "crossfading over " << m_fade.frames << " frames";
+}
+
+void Player::impl::start_writing() {
+    if(m_writes_held || m_ring.empty() || m_writing.exchange(true))
+        return;
+    async_write_ring();
+}
+
+void Player::impl::async_write_ring() {
+    assert(asioOutput);
+    // both halves of a wrapped ring go in one write; whatever the device doesn't take is written on completion,
+    // along with anything decoded meanwhile
+    asioOutput->async_write_some(m_ring.data(), [self = shared_from_this()](std::error_code ec, std::size_t n) {
+        self->write_handler(ec, n);
+    });
+}
+
+void Player::impl::write_handler(std::error_code ec, std::size_t n) {
     TRACE_LOG(logject) << "write_handler: " << n << " bytes written";
+    // partial writes leave the remainder in the ring for the next write
+    m_ring.consume(n);
+    if(!ec)
+        written_timeline(asioOutput->current_specs().bytes_to_samples(n));
+    // waking the decoder for less than a chunk of space only sends it back to sleep
+    if(m_ring.empty() || m_ring.write_available() >= m_decode_chunk.load(std::memory_order_relaxed))
+        m_decode_cv.notify_one();
+    m_stats.output_wakeups.fetch_add(1, std::memory_order_relaxed);
+    m_stats.write_size.record(n);
+    count_device_events();
+    if(m_ring.capacity() > 0)
+        m_stats.buffer_fill.record(m_ring.size() * 100 / m_ring.capacity());
+
     if(ec) {
+        m_writing = false;
         if(ec == std::errc::operation_canceled) {
             TRACE_LOG(logject) << ec.message();
+            // resume writing if the output was restarted while this write was cancelled
+            asio::post([self = shared_from_this()] {
+                unique_lock l(self->mu);
+                if(self->state_impl() == Output::DeviceState::Playing)
+                    self->start_writing();
+            });
             return;
         }
         ERROR_LOG(logject) << "write error: " << ec.message();
-        stop_impl();
+        asio::post([self = shared_from_this()] { self->stop(); });
         return;
     }
-    ec.clear();
 
-    if(!m_current_playlist || m_current_iterator == m_current_playlist->end()) {
-        TRACE_LOG(logject) << "no current track; stopping";
-        ec = asio::error::make_error_code(asio::error::eof);
-        n = 0;
-    } else
-        try {
-            if(!m_current_source) {
-                if(m_next_source) // get pre-loaded source if available
-                    m_current_source = std::move(m_next_source);
-                else // otherwise open new source from playlist item. throws on error
-                    m_current_source = decman->open(*m_current_iterator);
-            }
-            const auto as = m_current_source->getAudioSpecs();
+    if(!m_ring.empty() && !m_writes_held) {
+        async_write_ring();
+        return;
+    }
+    m_writing = false;
+    if(m_writes_held)
+        return;
 
-            while(!in_buf.empty()) {
-                if(asio::buffer_size(asio::mutable_buffer(in_buf.front())) <= 0)
-                    in_buf.pop_front();
-                else {
-                    read_handler(ec, asio::buffer_size(asio::mutable_buffer(in_buf.front())));
-                    return;
-                }
-            }
+    if(m_decode_eof) {
+        // let the device play out what it holds
+        const auto out_as = asioOutput->current_specs();
+        std::error_code delay_ec;
+        auto held = asioOutput->delay(delay_ec);
+        if(delay_ec)
+            held = asioOutput->buffering().buffer_frames;
+        const auto wait = out_as.samples_to_time<chrono::milliseconds>(held);
+        TRACE_LOG(logject) << "end of playlist; stopping in " << wait.count() << "ms";
+        auto timer = std::make_shared<asio::steady_timer>(kernel.getIOService(), wait);
+        timer->async_wait([self = shared_from_this(), timer,
+                           generation = m_control_generation.load(std::memory_order_relaxed)](std::error_code ec) {
+            if(ec)
+                return;
+            lock_guard l(self->mu);
+            // played again, or otherwise told what to do, meanwhile
+            if(generation != self->m_control_generation.load(std::memory_order_relaxed))
+                return;
+            // stopping holds writes, so isn't done here on the audio thread
+            self->defer_to_decoder([p = self.get()] {
+                p->stop_impl();
+                p->m_ring.clear();
+            });
+        });
+        return;
+    }
 
-            n = as.time_to_bytes(buffer_time);
-            PCMBuffer tmp{::operator new(n), n};
-            tmp.audio_specs = as;
+    TRACE_LOG(logject) << "output waiting on decoder";
+    m_stats.decoder_underruns.fetch_add(1, std::memory_order_relaxed);
+    // the decoder may have committed after the ring was found empty but before m_writing was cleared
+    start_writing();
+}
 
-            auto n_decoded = m_current_source->decode(tmp, ec);
-            TRACE_LOG(logject) << "decoded to " << n_decoded << " bytes of PCM; " << tmp.audio_specs;
+void Player::impl::count_device_events() {
+    if(!asioOutput)
+        return;
+    const auto device = asioOutput->stats();
+    m_stats.device_xruns.fetch_add(device.xruns - m_device_counted.xruns, std::memory_order_relaxed);
+    m_stats.device_recoveries.fetch_add(device.recoveries - m_device_counted.recoveries, std::memory_order_relaxed);
+    m_device_counted = device;
+}
 
-            if(n_decoded < n && !m_current_source->valid()) {
-                TRACE_LOG(logject) << "track ended, starting next, if any";
-                next_impl();
-            }
-            if(n_decoded == 0) {
-                TRACE_LOG(logject) << "end of track";
-                ::operator delete(asio::buffer_cast<void*>(tmp));
-            } else if(as != asioOutput->current_specs()) {
-                auto new_as = as;
-                new_as.bps = asioOutput->current_specs().bps;
-                if(new_as != asioOutput->current_specs()) {
-                    // stop + play to force device to re-prepare
-                    TRACE_LOG(logject) << "AudioSpecs mismatch";
-                    ::operator delete(asio::buffer_cast<void*>(tmp));
-                    n_decoded = 0;
-                    m_current_state->stop();
-                    m_current_state->play();
-                    l.unlock();
-                    write_handler(ec, 0);
-                    return;
-                } else {
-                    // pad with zeroes or trim the fat
-                    TRACE_LOG(logject) << "bps mismatch; widening from " << static_cast<int>(as.bps) << " to "
-                                       << static_cast<int>(asioOutput->current_specs().bps);
-                    auto buf = widen(tmp, n_decoded, asioOutput->current_specs().bps);
-                    buf.audio_specs = tmp.audio_specs;
-                    buf.audio_specs.bps = asioOutput->current_specs().bps;
-                    n_decoded = asio::buffer_size(buf);
-                    in_buf.emplace_back(buf);
-
-                    ::operator delete(asio::buffer_cast<void*>(tmp));
-                }
-            } else
-                in_buf.emplace_back(tmp);
-            assert(!in_buf.empty());
-            assert(in_buf.back().audio_specs == asioOutput->current_specs());
-            n = n_decoded;
-        } catch(...) {
-            ERROR_LOG(logject) << boost::current_exception_diagnostic_information();
-            stop_impl();
-            next_impl();
-            if(m_current_iterator != m_current_playlist->end())
-                play_impl();
-        }
-    read_handler(ec, n);
+bool Player::impl::low_power_output() const {
+    return std::find(m_low_power_outputs.begin(), m_low_power_outputs.end(), outman->currentSinkName()) !=
+           m_low_power_outputs.end();
 }
 
-void Player::impl::read_handler(std::error_code ec, std::size_t n) {
-    TRACE_LOG(logject) << "read_handler: " << n << " bytes read";
-    if(ec || (in_buf.empty() && (ec = asio::error::make_error_code(asio::error::no_data)))) {
-        if(ec.value() == asio::error::eof && m_current_source) {
-            ec.clear();
-            write_handler(ec, 0);
-        }
-        if(ec == std::errc::operation_canceled) {
-            TRACE_LOG(logject) << ec.message();
-            assert(in_buf.empty());
-            return;
+chrono::milliseconds Player::impl::output_latency() const {
+    return chrono::milliseconds{low_power_output() ? m_low_power_latency_ms.load() : m_latency_ms.load()};
+}
+
+void Player::impl::commit_timeline(const size_t frames, const AudioSpecs out_as) {
+    if(!m_current_source || frames == 0)
+        return;
+    // frames ended at the source's position, less what the DSP chain holds back; the output rate is the source's
+    // unless resampling, which keeps time
+    chrono::microseconds end = m_current_source->tell();
+    if(!m_dsp.empty())
+        end -= out_as.samples_to_time<chrono::microseconds>(m_dsp.latency());
+    const auto start = std::max(end - out_as.samples_to_time<chrono::microseconds>(frames), 0us);
+    optional<Track> track;
+    if(m_current_playlist && valid_iterator(m_current_iterator, *m_current_playlist))
+        track = *m_current_iterator;
+    lock_guard l(m_timeline_mu);
+    m_timeline.commit({m_track_generation, std::move(track), m_current_source->duration()}, start, frames);
+    publish_timeline(chrono::steady_clock::now());
+}
+
+void Player::impl::written_timeline(const size_t frames) {
+    std::error_code ec;
+    const auto delay = asioOutput->delay(ec);
+    if(ec)
+        TRACE_LOG(logject) << "device delay unknown: " << ec.message();
+    const auto now = chrono::steady_clock::now();
+    optional<decltype(m_timeline)::position> heard;
+    {
+        lock_guard l(m_timeline_mu);
+        m_timeline.written(frames, delay, now);
+        publish_timeline(now);
+        heard = m_timeline.audible(now);
+    }
+    if(!heard)
+        return;
+    if(m_audible_generation != heard->source.generation) {
+        m_audible_generation = heard->source.generation;
+        trackChanged(heard->source.track);
+    }
+    if(now - m_last_position >= m_position_interval.load()) {
+        m_last_position = now;
+        notifyPlayPosition(chrono::duration_cast<chrono::milliseconds>(heard->pos), heard->source.duration);
+    }
+}
+
+void Player::impl::pause_timeline(const bool paused) {
+    const auto now = chrono::steady_clock::now();
+    lock_guard l(m_timeline_mu);
+    if(paused)
+        m_timeline.pause(now);
+    else
+        m_timeline.resume(now);
+    publish_timeline(now);
+}
+
+void Player::impl::publish_timeline(const chrono::steady_clock::time_point now) {
+    const auto heard = m_timeline.audible_span(now);
+    audible_estimate estimate{};
+    if(heard) {
+        estimate.valid = true;
+        estimate.running = heard->running;
+        estimate.pos = heard->from.pos.count();
+        estimate.until = heard->until.count();
+        estimate.at = now.time_since_epoch().count();
+    }
+    m_audible.store(estimate);
+
+    // only allocated when the track heard changes
+    optional<uint64_t> generation;
+    if(heard)
+        generation = heard->from.source.generation;
+    if(generation == m_published_generation && m_audible_track)
+        return;
+    m_published_generation = generation;
+    std::atomic_store(&m_audible_track,
+                      std::make_shared<const optional<Track>>(heard ? heard->from.source.track : nullopt));
+}
+
+size_t Player::impl::decode_to_ring(const AudioSpecs as, const AudioSpecs out_as, size_t frames,
+                                    std::error_code& ec) {
+    size_t n_decoded = 0;
+
+    if(!m_dsp.empty())
+        return decode_float_to_ring(as, out_as, frames, ec);
+
+    if(as.bps == out_as.bps) {
+        // decode straight into the free space of the ring
+        for(auto&& region : m_ring.prepare(out_as.samples_to_bytes(frames))) {
+            const auto size = asio::buffer_size(region);
+            if(size == 0)
+                break;
+            PCMBuffer buf{asio::buffer_cast<void*>(region), size};
+            const auto r = timed_decode(*m_current_source, buf, ec);
+            m_ring.commit(r);
+            n_decoded += r;
+            if(r < size || ec)
+                break;
         }
-        if(ec.value() == asio::error::eof) {
-            TRACE_LOG(logject) << ec.message();
-            assert(in_buf.empty());
-            std::this_thread::sleep_for(buffer_time);
-            stop_impl();
-            return;
+        return out_as.bytes_to_samples(n_decoded);
+    }
+
+    const auto from = sample_format_from_bps(as.bps), to = sample_format_from_bps(out_as.bps);
+    if(m_converter.from() != from || m_converter.to() != to) {
+        TRACE_LOG(logject) << "bps mismatch; converting from " << static_cast<int>(as.bps) << " to "
+                           << static_cast<int>(out_as.bps);
+        m_converter = sample_converter{from, to, m_dither.load() ? dither::tpdf : dither::none};
+    }
+    frames = std::min(frames, out_as.bytes_to_samples(m_ring.write_available()));
+    // convert in place where the source holds its PCM in memory
+    const auto view = m_current_source->view(as.samples_to_bytes(frames), ec);
+    const char* in_ptr = asio::buffer_cast<const char*>(view);
+    n_decoded = asio::buffer_size(view);
+    if(n_decoded == 0 && !ec) {
+        if(m_decode_buf.size() < as.samples_to_bytes(frames))
+            m_decode_buf.resize(as.samples_to_bytes(frames));
+
+        PCMBuffer buf{m_decode_buf.data(), as.samples_to_bytes(frames)};
+        n_decoded = timed_decode(*m_current_source, buf, ec);
+        in_ptr = m_decode_buf.data();
+    }
+
+    // both regions of the ring begin on a frame boundary
+    auto remaining = n_decoded;
+    size_t n_converted = 0;
+    for(auto&& region : m_ring.prepare(out_as.samples_to_bytes(as.bytes_to_samples(n_decoded)))) {
+        const auto in_n = as.samples_to_bytes(out_as.bytes_to_samples(asio::buffer_size(region)));
+        const auto n_in = std::min(in_n, remaining);
+        const auto n_out = m_converter.convert(in_ptr, n_in / as.bps_in_bytes(), asio::buffer_cast<char*>(region));
+        n_converted += n_out;
+        in_ptr += n_in;
+        remaining -= n_in;
+    }
+    m_ring.commit(n_converted);
+
+    return as.bytes_to_samples(n_decoded);
+}
+
+size_t Player::impl::crossfade_to_ring(const AudioSpecs as, const AudioSpecs out_as, size_t frames,
+                                       std::error_code& ec) {
+    assert(m_next_source);
+    frames = std::min({frames, out_as.bytes_to_samples(m_ring.write_available()), m_fade.frames - m_fade.pos});
+    const auto samples = frames * out_as.channels;
+
+    if(m_fade.out.size() < samples) {
+        m_fade.out.resize(samples);
+        m_fade.in.resize(samples);
+        m_fade.gain_out.resize(samples);
+        m_fade.gain_in.resize(samples);
+    }
+
+    const auto frames_out = timed_decode_float(*m_current_source, m_fade.out.data(), frames, ec);
+    // the incoming track ending or failing only leaves it silent; it's the outgoing one ending that ends the fade
+    std::error_code in_ec;
+    const auto frames_in = timed_decode_float(*m_next_source, m_fade.in.data(), frames, in_ec);
+    if(in_ec && in_ec != asio::error::eof)
+        ERROR_LOG(logject) << "Couldn't decode next track: " << in_ec.message();
+
+    // mix in float; whichever source comes up short is silent for the rest
+    const auto n = std::max(frames_out, frames_in);
+    std::fill(m_fade.out.begin() + frames_out * as.channels, m_fade.out.begin() + n * as.channels, 0.0f);
+    std::fill(m_fade.in.begin() + frames_in * as.channels, m_fade.in.begin() + n * as.channels, 0.0f);
+
+    equal_power_gains(m_fade.pos, m_fade.frames, n, out_as.channels, m_fade.gain_out.data(), m_fade.gain_in.data());
+    mix_fade(m_fade.out.data(), m_fade.gain_out.data(), m_fade.in.data(), m_fade.gain_in.data(), m_fade.out.data(),
+             n * out_as.channels);
+
+    commit_float(m_fade.out.data(), n * out_as.channels, out_as);
+
+    // the outgoing track has ended; the fade is complete
+    m_fade.pos = frames_out < frames || ec ? m_fade.frames : m_fade.pos + n;
+    return n;
+}
+
+size_t Player::impl::resample_to_ring(const AudioSpecs as, const AudioSpecs out_as, size_t frames,
+                                      std::error_code& ec) {
+    if(!m_resampler || m_resampler->channels() != as.channels || m_resampler->from_rate() != as.sample_rate ||
+       m_resampler->to_rate() != out_as.sample_rate) {
+        TRACE_LOG(logject) << "resampling from " << as.sample_rate << " to " << out_as.sample_rate;
+        m_resampler = std::make_unique<resampler>(as.channels, as.sample_rate, out_as.sample_rate);
+    }
+    frames = std::min(frames, out_as.bytes_to_samples(m_ring.write_available()));
+    // input whose output is sure to fit, with room to flush the resampler if the track ends
+    const auto flush = m_resampler->max_flush();
+    if(frames <= flush)
+        return 0;
+    const auto in_frames = (frames - flush - 1) * as.sample_rate / out_as.sample_rate;
+    assert(m_resampler->max_output(in_frames) + flush <= frames);
+
+    if(m_resample_in.size() < in_frames * as.channels)
+        m_resample_in.resize(in_frames * as.channels);
+    if(m_resample_out.size() < frames * out_as.channels)
+        m_resample_out.resize(frames * out_as.channels);
+
+    const auto n_decoded = timed_decode_float(*m_current_source, m_resample_in.data(), in_frames, ec);
+    auto n = m_resampler->process(m_resample_in.data(), n_decoded, m_resample_out.data());
+    // the track has ended; complete the output held back for the taps reaching past its end
+    if(ec || !m_current_source->valid())
+        n += m_resampler->flush(m_resample_out.data() + n * out_as.channels);
+    commit_float(m_resample_out.data(), n * out_as.channels, out_as);
+    return n;
+}
+
+void Player::impl::commit_float(float* in, size_t samples, const AudioSpecs out_as) {
+    if(!m_dsp.empty())
+        run_dsp(in, samples / out_as.channels, out_as.channels);
+
+    const auto to = sample_format_from_bps(out_as.bps);
+    const bool dithered = m_dither.load();
+    if(m_float_converter.from() != sample_format::f32 || m_float_converter.to() != to || m_float_dither != dithered) {
+        m_float_converter = sample_converter{sample_format::f32, to, dithered ? dither::tpdf : dither::none};
+        m_float_dither = dithered;
+    }
+    size_t n_converted = 0;
+    for(auto&& region : m_ring.prepare(samples * out_as.bps_in_bytes())) {
+        const auto count = std::min(samples, asio::buffer_size(region) / out_as.bps_in_bytes());
+        const auto n_out = m_float_converter.convert(in, count, asio::buffer_cast<char*>(region));
+        n_converted += n_out;
+        in += count;
+        samples -= count;
+    }
+    m_ring.commit(n_converted);
+}
+
+void Player::impl::update_dsp(const AudioSpecs out_as) {
+    if(m_dsp_changed) {
+        m_dsp = dspman->make_chain(m_dsp_names);
+        m_dsp_changed = false;
+    }
+    // DSP always runs in float; the result is converted to the output's format once, on entering the ring
+    const auto max_frames = out_as.time_to_samples(buffer_time.load());
+    if(!m_dsp.empty() && !m_dsp.prepared(out_as, max_frames))
+        m_dsp.prepare(out_as, max_frames);
+}
+
+bool Player::impl::drain_dsp(unique_lock& l) {
+    if(m_dsp.empty())
+        return true;
+    const auto out_as = asioOutput->current_specs();
+    if(!m_dsp_tail)
+        m_dsp_tail = m_dsp.tail();
+    const auto frames = std::min(*m_dsp_tail, out_as.bytes_to_samples(m_ring.write_available()));
+    if(frames > 0) {
+        if(m_dsp_buf.size() < frames * out_as.channels)
+            m_dsp_buf.resize(frames * out_as.channels);
+        std::fill_n(m_dsp_buf.begin(), frames * out_as.channels, 0.0f);
+        m_decoding = true;
+        {
+            unlock_guard u(l, &m_stats.lock_wait);
+            commit_float(m_dsp_buf.data(), frames * out_as.channels, out_as);
         }
-        ERROR_LOG(logject) << "read error: " << ec.message();
-        stop_impl();
-        return;
+        m_decoding = false;
+        m_decode_cv.notify_all();
+        *m_dsp_tail -= frames;
+        TRACE_LOG(logject) << "drained " << frames << " frames of DSP tail";
     }
-    assert(n > 0);
-    assert(!in_buf.empty());
+    if(*m_dsp_tail > 0)
+        return false;
+    m_dsp.reset();
+    m_dsp_tail = nullopt;
+    return true;
+}
 
-    PCMBuffer tmp{asio::buffer_cast<void*>(in_buf.front()), n};
-    assert(asio::buffer_cast<void*>(in_buf.front()) != nullptr);
-    in_buf.pop_front();
-    assert(asioOutput);
-    asio::post([ self = shared_from_this(), tmp ]() mutable {
-        unique_lock l(self->mu);
-        asio::async_write(*self->asioOutput, asio::buffer(tmp), [tmp, self](std::error_code ec, std::size_t n) {
-            assert(asio::buffer_cast<void*>(tmp) != nullptr);
-            if(n < asio::buffer_size(asio::mutable_buffer(tmp))) {
-                const auto s = asio::buffer_size(asio::mutable_buffer(tmp)) - n;
-                assert(s > 0);
-                auto* ptr = ::operator new(s);
-                std::memmove(ptr, asio::buffer_cast<uint8_t*>(tmp) + n, s);
+void Player::impl::run_dsp(float* samples, size_t frames, const unsigned channels) noexcept {
+    while(frames > 0) {
+        const auto block = std::min(frames, m_dsp.max_frames());
+        m_dsp.process(samples, block);
+        samples += block * channels;
+        frames -= block;
+    }
+}
 
-                unique_lock l(self->mu);
-                self->in_buf.emplace_front(ptr, s);
-            }
-            ::operator delete(asio::buffer_cast<void*>(tmp));
+// for DSP; the source decodes straight to float
+size_t Player::impl::decode_float_to_ring(const AudioSpecs as, const AudioSpecs out_as, size_t frames,
+                                          std::error_code& ec) {
+    frames = std::min(frames, out_as.bytes_to_samples(m_ring.write_available()));
+    if(m_dsp_buf.size() < frames * as.channels)
+        m_dsp_buf.resize(frames * as.channels);
 
-            self->write_handler(ec, n);
-        });
-    });
+    const auto n = timed_decode_float(*m_current_source, m_dsp_buf.data(), frames, ec);
+    commit_float(m_dsp_buf.data(), n * out_as.channels, out_as);
+    return n;
 }
 
 struct Error;
 struct Playing;
 
-struct Stopped : State {
-    explicit Stopped(StateChanged& sc) : State(sc) {
-        stateChanged(Output::DeviceState::Stopped);
+// waiting on the track and output to be opened, then the output negotiated; see Player::impl::open_for_play()
+// and Player::impl::output_prepared()
+struct Preparing : State {
+    explicit Preparing(StateChanged& sc) : State(sc) {
+        changed(Output::DeviceState::Preparing);
     }
 
     void play() override {
-        assert(stateMachine->m_current_playlist);
+        stateMachine->m_pause_when_prepared = false;
+    }
+    void pause() override {
+        stateMachine->m_pause_when_prepared = true;
+    }
+    void stop() override {
+        // an open in progress sees it's been stopped, and a prepare completing is ignored
+        stateMachine->m_open_pending = false;
+        stateMachine->m_open_at = nullopt;
+        stateMachine->m_pause_when_prepared = false;
+        auto ptr = stateMachine->changeState<Stopped>();
+        assert(ptr == this);
+    }
 
-        try {
-            if(!stateMachine->valid_iterator(stateMachine->m_current_iterator, *stateMachine->m_current_playlist))
-                stateMachine->jumpTo_impl(0);
-            if(!stateMachine->valid_iterator(stateMachine->m_current_iterator, *stateMachine->m_current_playlist))
-                return;
-            assert(stateMachine->valid_iterator(stateMachine->m_current_iterator, *stateMachine->m_current_playlist));
+    Output::DeviceState state() const override {
+        return Output::DeviceState::Preparing;
+    }
 
-            stateMachine->changeDevice();
+    void sinkChange() override {
+        // opened again, on the current sink
+        stateMachine->m_open_pending = true;
+        stateMachine->m_decode_cv.notify_all();
+    }
+};
 
-            assert(stateMachine->asioOutput);
-            if(!stateMachine->asioOutput)
-                BOOST_THROW_EXCEPTION(std::exception());
+struct Stopped : State {
+    explicit Stopped(StateChanged& sc) : State(sc) {
+        changed(Output::DeviceState::Stopped);
+    }
 
-            stateMachine->m_current_source = stateMachine->decman->open(*stateMachine->m_current_iterator);
+    void play() override {
+        assert(stateMachine->m_current_playlist);
 
-            if(!stateMachine->m_current_source)
-                return;
-            const AudioSpecs as = stateMachine->m_current_source->getAudioSpecs();
+        if(!stateMachine->valid_iterator(stateMachine->m_current_iterator, *stateMachine->m_current_playlist))
+            stateMachine->jumpTo_impl(0);
+        if(!stateMachine->valid_iterator(stateMachine->m_current_iterator, *stateMachine->m_current_playlist))
+            return;
 
-            stateMachine->asioOutput->prepare(as);
-            TRACE_LOG(stateMachine->logject) << "sink prepared with specs:\n" << as;
-            stateMachine->asioOutput->play();
-            auto ptr = stateMachine->changeState<Playing>();
-            assert(ptr == this);
-        } catch(...) {
-            ERROR_LOG(stateMachine->logject) << boost::current_exception_diagnostic_information();
-            stateMachine->changeState<Error>();
-        }
+        // opened on the decode thread; see Player::impl::open_for_play()
+        stateMachine->m_open_pending = true;
+        stateMachine->m_pause_when_prepared = false;
+        auto ptr = stateMachine->changeState<Preparing>();
+        assert(ptr == this);
+        stateMachine->m_decode_cv.notify_all();
     }
 
     Output::DeviceState state() const override {
@@ -496,7 +1222,7 @@ struct Stopped : State {
 
 struct Error : State {
     explicit Error(StateChanged& sc) : State(sc) {
-        stateChanged(Output::DeviceState::Error);
+        changed(Output::DeviceState::Error);
     }
 
     void play() override {
@@ -540,6 +1266,8 @@ struct Stop : virtual State {
     }
     virtual void stop() override {
         stateMachine->asioOutput->stop();
+        // drops any swap to another sink in progress
+        ++stateMachine->m_sink_generation;
         auto ptr = stateMachine->changeState<Stopped>();
         assert(ptr == this);
     }
@@ -561,11 +1289,12 @@ struct Playing : virtual State, Stop, Tell {
     explicit Playing(StateChanged& sc) : State(sc), Stop(sc), Tell(sc) {
         assert(stateMachine->asioOutput);
         assert(stateMachine->asioOutput->state() == Output::DeviceState::Playing);
-        stateChanged(Output::DeviceState::Playing);
+        changed(Output::DeviceState::Playing);
     }
 
     void pause() override {
         stateMachine->asioOutput->pause();
+        stateMachine->pause_timeline(true);
         auto ptr = stateMachine->changeState<Paused>();
         assert(ptr == this);
     }
@@ -575,22 +1304,19 @@ struct Playing : virtual State, Stop, Tell {
     }
 
     void sinkChange() override {
-        auto time(tell());
-        stateMachine->asioOutput->stop();
-        stateMachine->changeDevice();
-        stateMachine->play_impl();
-        stateMachine->m_current_source->seek(time);
+        stateMachine->swap_output();
     }
 };
 
 struct Paused : virtual State, Stop, Tell {
     explicit Paused(StateChanged& sc) : State(sc), Stop(sc), Tell(sc) {
         assert(stateMachine->asioOutput);
-        stateChanged(Output::DeviceState::Paused);
+        changed(Output::DeviceState::Paused);
     }
 
     void play() override {
         stateMachine->asioOutput->play();
+        stateMachine->pause_timeline(false);
         auto ptr = stateMachine->changeState<Playing>();
         assert(ptr == this);
     }
@@ -600,34 +1326,50 @@ struct Paused : virtual State, Stop, Tell {
     }
 
     void sinkChange() override {
-        auto time(tell());
-        stateMachine->asioOutput->stop();
-        stateMachine->changeDevice();
-        stateMachine->play_impl();
-        stateMachine->m_current_source->seek(time);
-        stateMachine->pause_impl();
+        // resuming plays the new device from where the old one paused
+        stateMachine->swap_output();
     }
 };
 
 Player::impl::impl(Kernel& kernel)
     : kernel(kernel), playman(kernel.getPlaylistManager()), outman(kernel.getOutputManager()),
-      confman(kernel.getConfigManager()), decman(kernel.getDecoderManager()), mu(), stateChanged(),
+      confman(kernel.getConfigManager()), decman(kernel.getDecoderManager()), dspman(kernel.getDSPManager()), mu(),
+      stateChanged(),
       m_current_state((State::stateMachine = this, // init statics before first construction
                        State::playman = playman, // dirty comma operator usage
                        std::make_shared<Stopped>(stateChanged))),
       logject(logging::keywords::channel = "StateMachine") {
-    conf.putNode("gapless preload time", static_cast<int64_t>(m_gapless_preload.count()));
+    conf.putNode("gapless preload time", static_cast<int64_t>(m_gapless_preload.load().count()));
+    conf.putNode("crossfade time", static_cast<int64_t>(m_crossfade.load().count()));
+    // "reopen" the device or "resample"
+    conf.putNode("sample rate change", std::string("reopen"));
+    // names of DSP providers, applied in order
+    conf.putNode("dsp chain", std::vector<Config::VarType>{});
+    conf.putNode("decode ahead time", static_cast<int64_t>(m_decode_ahead.load().count()));
+    conf.putNode("dither", m_dither.load());
+    conf.putNode("position interval", static_cast<int64_t>(m_position_interval.load().count()));
     playman->getCurrentPlaylistChangedSignal().connect(&impl::currentPlaylistChangedSlot, this);
     outman->getPlayerSinkChangedSignal().connect(&impl::sinkChangeSlot, this);
     confman->getLoadedSignal().connect(&impl::loadedSlot, this);
     notifyPlayPosition.connect([this](chrono::milliseconds pos, chrono::milliseconds dur) {
         TRACE_LOG(logject) << "pos: " << pos.count() << "; dur: " << dur.count();
     });
+    m_decode_thread = std::thread(&impl::decode_loop, this);
 }
 
 Player::impl::~impl() {
-    stop();
+    {
+        lock_guard l(mu);
+        m_decode_thread_stop = true;
+    }
+    m_decode_cv.notify_all();
+    m_decode_thread.join();
+
     lock_guard l(mu);
+    // nothing is decoded or prepared any more, so nothing need be deferred
+    m_requests.clear();
+    stop_impl();
+    m_ring.clear();
     if(asioOutput)
         asioOutput->cancel();
     asioOutput.reset();
@@ -642,18 +1384,89 @@ void Player::impl::pause_impl() {
 }
 
 void Player::impl::stop_impl() {
-    m_current_state->stop();
+    {
+        writes_held held{*this};
+        m_current_state->stop();
+    }
     if(m_current_source) {
         m_current_source->reset();
         m_current_source.reset();
     }
     jumpTo_impl(m_current_playlist->size());
+    m_track_change_start = {};
+    m_resampler.reset();
+    m_dsp.reset();
+    m_dsp_tail = nullopt;
+    {
+        lock_guard l(m_timeline_mu);
+        m_timeline.reset(0);
+        publish_timeline(chrono::steady_clock::now());
+    }
+    m_audible_generation = nullopt;
 }
 
 void Player::impl::seek(chrono::milliseconds dur) {
     TRACE_LOG(logject) << "Seek...";
-    if(m_current_source)
+    lock_guard l(mu);
+    request([this, dur] {
+        if(!m_current_source)
+            return;
         m_current_source->seek(dur);
+        flush_output();
+        hold_timeline_at(dur);
+    });
+}
+
+void Player::impl::hold_timeline_at(const chrono::milliseconds pos) {
+    if(!m_current_source)
+        return;
+    optional<Track> track;
+    if(m_current_playlist && valid_iterator(m_current_iterator, *m_current_playlist))
+        track = *m_current_iterator;
+    lock_guard l(m_timeline_mu);
+    m_timeline.reset(m_timeline.rate(), {m_track_generation, std::move(track), m_current_source->duration()}, pos);
+    publish_timeline(chrono::steady_clock::now());
+}
+
+void Player::impl::track_requested() {
+    if(!m_current_playlist || !valid_iterator(m_current_iterator, *m_current_playlist)) {
+        stop_impl();
+        m_ring.clear();
+        return;
+    }
+    flush_output();
+    hold_timeline_at(0ms);
+}
+
+void Player::impl::flush_output() {
+    writes_held held{*this};
+    const auto state = state_impl();
+    if(state == Output::DeviceState::Playing || state == Output::DeviceState::Paused) {
+        // re-preparing for the specs it already has needn't negotiate with the device again
+        const auto out_as = asioOutput->current_specs();
+        std::error_code ec;
+        asioOutput->stop(ec);
+        if(!ec)
+            asioOutput->prepare(out_as, ec);
+        if(!ec && state == Output::DeviceState::Playing)
+            asioOutput->play(ec);
+        if(ec) {
+            ERROR_LOG(logject) << "Couldn't restart output: " << ec.message();
+            changeState<Error>();
+        }
+    }
+    m_ring.clear();
+    m_resampler.reset();
+    m_dsp.reset();
+    m_dsp_tail = nullopt;
+    // the incoming track was part decoded; opened afresh when it's next needed
+    if(m_fade.frames > 0) {
+        m_next_source.reset();
+        m_fade.frames = 0;
+    }
+    lock_guard l(m_timeline_mu);
+    m_timeline.reset(m_timeline.rate());
+    publish_timeline(chrono::steady_clock::now());
 }
 
 chrono::milliseconds Player::impl::tell_impl() {
@@ -676,10 +1489,12 @@ void Player::impl::next_impl() {
     }
     if(m_current_iterator != m_current_playlist->end()) {
         ++m_current_iterator;
+        ++m_track_generation;
+        m_fade.frames = 0;
+        track_changed();
+        // without a pre-loaded source, the decode thread opens the track outside of mu
         if(m_next_source)
             m_current_source = std::move(m_next_source);
-        else if(m_current_iterator != m_current_playlist->end())
-            m_current_source = decman->open(*m_current_iterator);
     }
     if(m_current_iterator == m_current_playlist->end())
         m_current_iterator = m_current_playlist->end();
@@ -699,6 +1514,9 @@ void Player::impl::previous_impl() {
             m_current_source.reset();
         }
         --m_current_iterator;
+        ++m_track_generation;
+        m_fade.frames = 0;
+        track_changed();
     } else if(m_current_source)
         m_current_source->reset();
 }
@@ -718,13 +1536,20 @@ void Player::impl::jumpTo_impl(int p) {
         m_current_iterator = m_current_playlist->begin() + p;
     else
         m_current_iterator = m_current_playlist->end();
+    ++m_track_generation;
+    m_fade.frames = 0;
+    track_changed();
     if(p == 1)
         m_current_source = std::move(m_next_source);
 }
 
 void Player::impl::currentPlaylistChangedSlot(optional<Playlist> p) {
-    m_current_playlist = p;
-    jumpTo(0);
+    std::atomic_store(&m_playlist_snapshot, std::make_shared<const optional<Playlist>>(p));
+    lock_guard l(mu);
+    request([this, p = std::move(p)] {
+        m_current_playlist = p;
+        jumpTo_impl(0);
+    });
 }
 
 void Player::impl::trackChangeSlot(int, optional<Track> t) {
@@ -736,25 +1561,252 @@ void Player::impl::trackChangeSlot(int, optional<Track> t) {
 void Player::impl::changeDevice() {
     TRACE_LOG(logject) << "changeDevice()";
     if(asioOutput) {
-        asioOutput->cancel();
+        writes_held held{*this};
         asioOutput->stop();
+        count_device_events();
+        // stopped, not closed; picked back up if this sink is chosen again
+        outman->keepASIOSink(m_sink_name, std::move(asioOutput));
     }
+    m_sink_name = outman->currentSinkName();
     asioOutput = outman->createASIOSink();
+    if(asioOutput)
+        m_device_counted = asioOutput->stats();
 }
 
-void Player::impl::sinkChangeSlot() {
-    TRACE_LOG(logject) << "sinkChangeSlot()";
-    unique_lock l(mu);
+void Player::impl::open_for_play(unique_lock& l) {
+    m_open_pending = false;
+    // stopped meanwhile
+    if(state_impl() != Output::DeviceState::Preparing)
+        return;
+    if(!m_current_playlist || !valid_iterator(m_current_iterator, *m_current_playlist)) {
+        changeState<Stopped>();
+        return;
+    }
+    const Track track = *m_current_iterator;
+    const auto generation = m_track_generation;
+    // put by first, so if it's still the chosen sink it's picked back up rather than opened twice
+    if(asioOutput) {
+        writes_held held{*this};
+        asioOutput->stop();
+        count_device_events();
+        outman->keepASIOSink(m_sink_name, std::move(asioOutput));
+    }
+    std::string name;
+    std::unique_ptr<AudioIO::AudioOutputBase> output;
+    std::unique_ptr<Decoder::PCMSource> source;
+    // asioOutput is null meanwhile, so requests wait
+    m_opening = true;
     try {
-        m_current_state->sinkChange();
+        unlock_guard u(l);
+        name = outman->currentSinkName();
+        output = outman->createASIOSink();
+        source = decman->open(track);
     } catch(...) {
+        m_opening = false;
+        m_decode_cv.notify_all();
         ERROR_LOG(logject) << boost::current_exception_diagnostic_information();
+        outman->keepASIOSink(name, std::move(output));
+        if(state_impl() == Output::DeviceState::Preparing)
+            changeState<Error>();
+        return;
+    }
+    m_opening = false;
+    m_decode_cv.notify_all();
+    m_sink_name = std::move(name);
+    asioOutput = std::move(output);
+    if(asioOutput)
+        m_device_counted = asioOutput->stats();
+    if(state_impl() != Output::DeviceState::Preparing)
+        return;
+    // the track changed meanwhile; open that instead
+    if(generation != m_track_generation) {
+        m_open_at = nullopt;
+        m_open_pending = true;
+        return;
+    }
+    if(!source) {
+        changeState<Stopped>();
+        return;
+    }
+    m_current_source = std::move(source);
+    if(m_open_at) {
+        m_current_source->seek(*m_open_at);
+        m_open_at = nullopt;
+    }
+    async_prepare_output(m_current_source->getAudioSpecs());
+}
 
-        stop_impl();
+void Player::impl::restart_output(const bool paused) {
+    // the state stopped here is the one calling
+    const auto keep = m_current_state;
+    optional<chrono::milliseconds> resume_at;
+    {
+        lock_guard l(m_timeline_mu);
+        const auto heard = m_timeline.audible(chrono::steady_clock::now());
+        if(heard && heard->source.generation == m_track_generation)
+            resume_at = chrono::duration_cast<chrono::milliseconds>(heard->pos);
+    }
+    {
+        writes_held held{*this};
+        m_current_state->stop();
+    }
+    flush_output();
+    TRACE_LOG(logject) << "Restarting on output " << outman->currentSinkName();
+    // reopens the track and prepares the new device
+    play_impl();
+    m_open_at = resume_at;
+    if(paused)
+        pause_impl();
+}
+
+void Player::impl::async_prepare_output(const AudioSpecs as) {
+    asioOutput->latency(output_latency());
+    m_preparing = true;
+    asioOutput->async_prepare(as, [self = shared_from_this()](std::error_code ec, AudioSpecs out_as) {
+        lock_guard l(self->mu);
+        self->m_preparing = false;
+        // ahead of the requests that waited on it
+        self->defer_to_decoder([self = self.get(), ec, out_as] { self->output_prepared(ec, out_as); }, true);
+    });
+}
+
+void Player::impl::output_prepared(std::error_code ec, const AudioSpecs out_as) {
+    // stopped, or stopped and played again, meanwhile
+    if(state_impl() != Output::DeviceState::Preparing || m_open_pending)
+        return;
+    if(ec) {
+        ERROR_LOG(logject) << "Couldn't prepare output: " << ec.message();
+        changeState<Error>();
+        return;
+    }
+    TRACE_LOG(logject) << "sink prepared with specs:\n" << out_as;
+
+    const bool low_power = low_power_output();
+    const auto latency = output_latency();
+    {
+        lock_guard tl(m_timeline_mu);
+        m_timeline.reset(out_as.sample_rate);
+        publish_timeline(chrono::steady_clock::now());
+    }
+    // written audio the device may yet drop, kept in the ring so swap_output() can replay it
+    const auto reserve = out_as.samples_to_bytes(asioOutput->buffering().buffer_frames);
+    if(low_power) {
+        // decode a whole burst at a time into a ring holding two; the device buffer covers decoding the next
+        const auto burst = std::max({m_decode_ahead.load(), buffer_time.load(), latency});
+        m_ring.reset(out_as.time_to_bytes(burst * 2) + reserve, reserve);
+        m_decode_chunk = out_as.time_to_bytes(burst);
+        LOG(logject) << "Low power output; decoding in bursts of " << burst.count() << "ms";
+    } else {
+        m_ring.reset(out_as.time_to_bytes(std::max(m_decode_ahead.load(), buffer_time.load())) + reserve, reserve);
+        m_decode_chunk = std::min(out_as.time_to_bytes(buffer_time.load()), m_ring.capacity() - reserve);
+    }
+
+    if(m_pause_when_prepared) {
+        changeState<Paused>();
+        return;
+    }
+    try {
+        asioOutput->play();
+    } catch(...) {
+        ERROR_LOG(logject) << boost::current_exception_diagnostic_information();
         changeState<Error>();
+        return;
+    }
+    changeState<Playing>();
+    m_decode_cv.notify_all();
+    start_writing();
+}
+
+void Player::impl::swap_output() {
+    assert(asioOutput);
+    const auto generation = ++m_sink_generation;
+    const auto name = outman->currentSinkName();
+    std::unique_ptr<AudioIO::AudioOutputBase> next;
+    try {
+        next = outman->createASIOSink();
+    } catch(...) {
+        ERROR_LOG(logject) << boost::current_exception_diagnostic_information();
+        restart_output(state_impl() == Output::DeviceState::Paused);
+        return;
+    }
+    next->latency(output_latency());
+    auto* const device = next.get();
+    // the handler must be copyable; the device is handed back with it
+    auto held = std::make_shared<std::unique_ptr<AudioIO::AudioOutputBase>>(std::move(next));
+    device->async_prepare(asioOutput->current_specs(), [self = shared_from_this(), held, name,
+                                                         generation](std::error_code ec, AudioSpecs prepared) {
+        lock_guard l(self->mu);
+        // swapping holds writes, and rewinding m_ring has to wait for the decode thread to be done with it
+        self->defer_to_decoder([self = self.get(), ec, prepared, held, name, generation] {
+            // another sink was chosen meanwhile
+            if(generation != self->m_sink_generation) {
+                self->outman->keepASIOSink(name, std::move(*held));
+                return;
+            }
+            self->output_swap_prepared(ec, prepared, std::move(*held), name);
+        });
+    });
+}
+
+void Player::impl::output_swap_prepared(std::error_code ec, const AudioSpecs prepared,
+                                        std::unique_ptr<AudioIO::AudioOutputBase> next, std::string name) {
+    const auto state = state_impl();
+    // stopped meanwhile; kept for when playing starts again
+    if(state != Output::DeviceState::Playing && state != Output::DeviceState::Paused) {
+        outman->keepASIOSink(name, std::move(next));
+        return;
+    }
+    const auto out_as = asioOutput->current_specs();
+    if(ec || prepared != out_as) {
+        LOG(logject) << "Output " << name << " can't take " << out_as << "; restarting";
+        outman->keepASIOSink(name, std::move(next));
+        restart_output(state == Output::DeviceState::Paused);
+        return;
+    }
+
+    {
+        writes_held held{*this};
+        std::error_code delay_ec;
+        const auto frames = asioOutput->delay(delay_ec);
+        asioOutput->stop();
+        // the old device's queue is lost; replay it from the ring's reserve, so the new one starts at the next
+        // unheard frame
+        const auto replay = out_as.bytes_to_samples(m_ring.rewind(out_as.samples_to_bytes(frames)));
+        {
+            lock_guard l(m_timeline_mu);
+            m_timeline.rewind(replay);
+            publish_timeline(chrono::steady_clock::now());
+        }
+        TRACE_LOG(logject) << "Swapping output to " << name << "; replaying " << replay << " of " << frames
+                           << " frames";
+
+        count_device_events();
+        outman->keepASIOSink(m_sink_name, std::move(asioOutput));
+        asioOutput = std::move(next);
+        m_device_counted = asioOutput->stats();
+        m_sink_name = std::move(name);
+    }
+    if(state == Output::DeviceState::Playing) {
+        asioOutput->play();
+        start_writing();
     }
 }
 
+void Player::impl::sinkChangeSlot() {
+    TRACE_LOG(logject) << "sinkChangeSlot()";
+    lock_guard l(mu);
+    run_or_defer([this] {
+        try {
+            m_current_state->sinkChange();
+        } catch(...) {
+            ERROR_LOG(logject) << boost::current_exception_diagnostic_information();
+
+            stop_impl();
+            changeState<Error>();
+        }
+    });
+}
+
 Player::Player(Kernel& kernel) : pimpl(new impl(kernel)) {
 }
 
@@ -787,14 +1839,13 @@ chrono::milliseconds Player::tell() const {
 }
 
 optional<Playlist> Player::currentPlaylist() const {
-    lock_guard l(pimpl->mu);
-    return pimpl->m_current_playlist;
+    auto playlist = std::atomic_load(&pimpl->m_playlist_snapshot);
+    return playlist ? *playlist : nullopt;
 }
 
 optional<Track> Player::currentTrack() const {
-    lock_guard l(pimpl->mu);
-    return nullopt;
-    //    return pimpl->m_current_track;
+    auto track = std::atomic_load(&pimpl->m_audible_track);
+    return track ? *track : nullopt;
 }
 
 void Player::next() {
@@ -810,13 +1861,49 @@ void Player::jumpTo(int p) {
 }
 
 tuple<optional<Playlist>, optional<Track>> Player::current() const {
-    lock_guard l(pimpl->mu);
-    return std::make_tuple(pimpl->m_current_playlist, nullopt);
+    return std::make_tuple(currentPlaylist(), currentTrack());
+}
+
+PlayerStats Player::stats() const {
+    PlayerStats s;
+    s.decode_time = pimpl->m_stats.decode_time.read();
+    s.lock_wait = pimpl->m_stats.lock_wait.read();
+    s.buffer_fill = pimpl->m_stats.buffer_fill.read();
+    s.write_size = pimpl->m_stats.write_size.read();
+    s.track_change = pimpl->m_stats.track_change.read();
+    s.decoder_underruns = pimpl->m_stats.decoder_underruns.load(std::memory_order_relaxed);
+    s.decode_interval = pimpl->m_stats.decode_interval.read();
+    s.decode_wakeups = pimpl->m_stats.decode_wakeups.load(std::memory_order_relaxed);
+    s.output_wakeups = pimpl->m_stats.output_wakeups.load(std::memory_order_relaxed);
+    s.elapsed = chrono::steady_clock::now().time_since_epoch() -
+                chrono::steady_clock::duration(pimpl->m_stats.since.load(std::memory_order_relaxed));
+    s.device_xruns = pimpl->m_stats.device_xruns.load(std::memory_order_relaxed);
+    s.device_recoveries = pimpl->m_stats.device_recoveries.load(std::memory_order_relaxed);
+    return s;
+}
+
+void Player::resetStats() {
+    pimpl->m_stats.decode_time.reset();
+    pimpl->m_stats.lock_wait.reset();
+    pimpl->m_stats.buffer_fill.reset();
+    pimpl->m_stats.write_size.reset();
+    pimpl->m_stats.track_change.reset();
+    pimpl->m_stats.decoder_underruns.store(0, std::memory_order_relaxed);
+    pimpl->m_stats.decode_interval.reset();
+    pimpl->m_stats.decode_wakeups.store(0, std::memory_order_relaxed);
+    pimpl->m_stats.output_wakeups.store(0, std::memory_order_relaxed);
+    pimpl->m_stats.device_xruns.store(0, std::memory_order_relaxed);
+    pimpl->m_stats.device_recoveries.store(0, std::memory_order_relaxed);
+    pimpl->m_stats.since.store(chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
 }
 
 Signals::Player::StateChanged& Player::stateChangedSignal() const {
     return pimpl->stateChanged;
 }
 
+Signals::Player::TrackChanged& Player::trackChangedSignal() const {
+    return pimpl->trackChanged;
+}
+
 } // namespace Core
 } // namespace Melosic
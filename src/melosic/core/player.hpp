@@ -25,6 +25,7 @@ using std::tuple;
 namespace chrono = std::chrono;
 
 #include <melosic/common/optional.hpp>
+#include <melosic/common/histogram.hpp>
 #include <melosic/common/signal_fwd.hpp>
 #include <melosic/core/player_signals.hpp>
 #include <melosic/common/common.hpp>
@@ -42,6 +43,33 @@ class Kernel;
 class Playlist;
 class Track;
 
+/// Measurements of the playback pipeline, cumulative since construction or resetStats().
+struct PlayerStats {
+    /// microseconds per call into the decoder
+    histogram::summary decode_time;
+    /// microseconds the decode thread waited to retake the player lock after decoding
+    histogram::summary lock_wait;
+    /// percentage of the decode-ahead buffer filled as each write to the output completes
+    histogram::summary buffer_fill;
+    /// bytes per write to the output
+    histogram::summary write_size;
+    /// microseconds from changing track to the first frame of the new track being decoded
+    histogram::summary track_change;
+    /// times the output was left waiting on the decoder mid-playlist
+    uint64_t decoder_underruns = 0;
+    /// underruns reported by the output devices themselves, over every device played to
+    uint64_t device_xruns = 0;
+    uint64_t device_recoveries = 0;
+    /// microseconds between the decoder's bursts of work
+    histogram::summary decode_interval;
+    /// times the decode thread woke to work; notifications finding too little room to decode into aren't counted
+    uint64_t decode_wakeups = 0;
+    /// write completions, each a wakeup of the audio thread
+    uint64_t output_wakeups = 0;
+    /// time the above were gathered over, for turning counts into rates
+    chrono::nanoseconds elapsed{0};
+};
+
 class MELOSIC_EXPORT Player final {
   public:
     explicit Player(Core::Kernel&);
@@ -67,7 +95,12 @@ class MELOSIC_EXPORT Player final {
     void jumpTo(int);
     tuple<optional<Playlist>, optional<Track>> current() const;
 
+    PlayerStats stats() const;
+    void resetStats();
+
     Signals::Player::StateChanged& stateChangedSignal() const;
+    /// When a different track becomes audible, rather than when it starts decoding.
+    Signals::Player::TrackChanged& trackChangedSignal() const;
 
     struct impl;
 
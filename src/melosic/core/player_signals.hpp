@@ -21,6 +21,7 @@
 #include <chrono>
 namespace chrono = std::chrono;
 
+#include <melosic/common/optional.hpp>
 #include <melosic/common/signal_fwd.hpp>
 
 namespace Melosic {
@@ -28,12 +29,16 @@ namespace Melosic {
 namespace Output {
 enum class DeviceState;
 }
+namespace Core {
+class Track;
+}
 
 namespace Signals {
 
 namespace Player {
 typedef SignalCore<void(Melosic::Output::DeviceState)> StateChanged;
 typedef SignalCore<void(chrono::milliseconds /*current*/, chrono::milliseconds /*total*/)> NotifyPlayPos;
+typedef SignalCore<void(optional<Core::Track>)> TrackChanged;
 }
 }
 }
@@ -104,6 +104,7 @@ class Track::impl {
     chrono::milliseconds start{0}, end{0};
     boost::synchronized_value<TagMap> m_tags;
     AudioSpecs as;
+    seek_index m_seek_index;
     TagsChanged tagsChanged;
     mutex mu;
 };
@@ -176,6 +177,36 @@ Track::Track(const jbson::document& track_doc) : pimpl(std::make_shared<impl>())
                 tags.emplace(std::move(pair));
             }
             pimpl->m_tags = boost::synchronized_value<TagMap>(std::move(tags));
+        } else if(element.name() == "seek index") {
+            decltype(jbson::get<element_type::document_element>(element)) index_doc;
+            try {
+                index_doc = jbson::get<element_type::document_element>(element);
+            } catch(...) {
+                std::throw_with_nested(std::runtime_error("'seek index' should be a document"));
+            }
+
+            auto it = index_doc.find("spacing");
+            if(it == index_doc.end() || it->type() != element_type::int64_element)
+                BOOST_THROW_EXCEPTION(std::runtime_error("seek index must have spacing"));
+            const auto spacing = it->value<int64_t>();
+
+            it = index_doc.find("points");
+            if(it == index_doc.end() || it->type() != element_type::array_element)
+                BOOST_THROW_EXCEPTION(std::runtime_error("seek index must have points"));
+            // flattened sample, offset pairs
+            std::vector<int64_t> values;
+            for(auto&& v : jbson::get<element_type::array_element>(*it)) {
+                if(v.type() != element_type::int64_element)
+                    BOOST_THROW_EXCEPTION(std::runtime_error("seek points should be integers"));
+                values.push_back(v.value<int64_t>());
+            }
+            if(values.size() % 2 != 0)
+                BOOST_THROW_EXCEPTION(std::runtime_error("seek points should be sample, offset pairs"));
+
+            std::vector<seek_point> points;
+            for(size_t i = 0; i < values.size(); i += 2)
+                points.push_back({static_cast<uint64_t>(values[i]), static_cast<uint64_t>(values[i + 1])});
+            pimpl->m_seek_index = seek_index{static_cast<uint64_t>(spacing), std::move(points)};
         }
     }
 
@@ -200,6 +231,11 @@ void Track::audioSpecs(AudioSpecs as) {
     pimpl->as = as;
 }
 
+void Track::seekIndex(seek_index index) {
+    lock_guard l(pimpl->mu);
+    pimpl->m_seek_index = std::move(index);
+}
+
 void Track::start(chrono::milliseconds start) {
     lock_guard l(pimpl->mu);
     pimpl->start = start;
@@ -230,6 +266,11 @@ Melosic::AudioSpecs Track::audioSpecs() const {
     return pimpl->as;
 }
 
+seek_index Track::seekIndex() const {
+    shared_lock l(pimpl->mu);
+    return pimpl->m_seek_index;
+}
+
 optional<std::string> Track::tag(const std::string& key) const {
     shared_lock l(pimpl->mu);
     return pimpl->getTag(key);
@@ -283,6 +324,16 @@ Signals::Track::TagsChanged& Track::getTagsChangedSignal() const noexcept {
     return pimpl->tagsChanged;
 }
 
+jbson::document seek_index_bson(const seek_index& index) {
+    using jbson::element_type;
+    jbson::array_builder points;
+    for(auto&& point : index.points())
+        points(element_type::int64_element, static_cast<int64_t>(point.sample))(element_type::int64_element,
+                                                                                 static_cast<int64_t>(point.offset));
+    return jbson::builder("spacing", element_type::int64_element, static_cast<int64_t>(index.spacing()))(
+        "points", element_type::array_element, points);
+}
+
 jbson::document Track::bson() const {
     using std::get;
     using jbson::element_type;
@@ -304,6 +355,9 @@ jbson::document Track::bson() const {
     });
     ob("metadata", element_type::array_element, arr);
 
+    if(!pimpl->m_seek_index.empty())
+        ob("seek index", element_type::document_element, seek_index_bson(pimpl->m_seek_index));
+
     return ob;
 }
 
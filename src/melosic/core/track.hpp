@@ -32,6 +32,7 @@
 #include <melosic/common/common.hpp>
 #include <melosic/common/signal_fwd.hpp>
 #include <melosic/common/optional.hpp>
+#include <melosic/common/seek_index.hpp>
 
 namespace Melosic {
 
@@ -64,6 +65,7 @@ class MELOSIC_EXPORT Track final {
     void audioSpecs(AudioSpecs);
     void start(chrono::milliseconds start);
     void end(chrono::milliseconds end);
+    void seekIndex(seek_index);
 
     explicit Track(const web::uri& location, chrono::milliseconds end = 0ms, chrono::milliseconds start = 0ms);
 
@@ -78,6 +80,7 @@ class MELOSIC_EXPORT Track final {
     chrono::milliseconds end() const;
     chrono::milliseconds duration() const;
     Melosic::AudioSpecs audioSpecs() const;
+    seek_index seekIndex() const;
 
     const web::uri& uri() const;
     optional<std::string> tag(const std::string& key) const;
@@ -102,6 +105,9 @@ bool operator<(const Track&, const Track&);
 
 size_t hash_value(const Track& b);
 
+/// How a track's seek index is stored in its library document, under "seek index".
+MELOSIC_EXPORT jbson::document seek_index_bson(const seek_index&);
+
 } // namespace Core
 } // namespace Melosic
 
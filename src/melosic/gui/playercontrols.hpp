@@ -55,6 +55,7 @@ class PlayerControls : public QObject {
         Paused,
         Stopped,
         Initial,
+        Preparing,
     };
 
     virtual ~PlayerControls();
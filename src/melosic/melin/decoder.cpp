@@ -22,6 +22,7 @@
 #include <functional>
 namespace ph = std::placeholders;
 #include <mutex>
+#include <thread>
 using mutex = std::mutex;
 using unique_lock = std::unique_lock<mutex>;
 
@@ -48,7 +49,9 @@ namespace fs = boost::filesystem;
 #include <melosic/core/audiofile.hpp>
 #include <melosic/melin/input.hpp>
 #include <melosic/common/pcmbuffer.hpp>
+#include <melosic/common/sample_convert.hpp>
 #include <melosic/common/typeid.hpp>
+#include <melosic/common/signal.hpp>
 
 #include "decoder.hpp"
 
@@ -59,6 +62,10 @@ using namespace TagLib;
 
 Logger::Logger logject{logging::keywords::channel = "Decoder::Manager"};
 
+struct SeekIndexed : Signals::Signal<Signals::Decoder::SeekIndexed> {
+    using Super::Signal;
+};
+
 struct Manager::impl : std::enable_shared_from_this<impl> {
     impl(const std::shared_ptr<Input::Manager>& inman, const std::shared_ptr<Plugin::Manager>& plugman)
         : inman(inman), plugman(plugman) {
@@ -69,6 +76,7 @@ struct Manager::impl : std::enable_shared_from_this<impl> {
     std::unordered_map<std::string, Factory> inputFactories;
     Core::FileCache m_file_cache;
     std::vector<std::shared_ptr<provider>> providers;
+    SeekIndexed seekIndexed;
 
     std::unique_ptr<PCMSource> open(const web::uri&);
 };
@@ -241,6 +249,26 @@ struct TrackSource : PCMSource {
         TRACE_LOG(logject) << "Decoded " << bytes << " bytes; adjusted for time";
         return bytes;
     }
+    ConstPCMBuffer view(size_t max_bytes, std::error_code& ec) override {
+        const auto now = pimpl->tell();
+        if(now >= m_end) {
+            ec = asio::error::eof;
+            return {};
+        }
+        return pimpl->view(std::min(max_bytes, getAudioSpecs().time_to_bytes(m_end - now)), ec);
+    }
+    size_t decode_float(float* out, size_t frames, std::error_code& ec) override {
+        if(pimpl->tell() >= m_end) {
+            ec = asio::error::eof;
+            return 0;
+        }
+        const auto as = getAudioSpecs();
+        auto n = pimpl->decode_float(out, frames, ec);
+        auto time = pimpl->tell() + as.samples_to_time<std::chrono::milliseconds>(n);
+        if(time > m_end)
+            n -= std::min(n, as.time_to_samples(time - m_end));
+        return n;
+    }
     bool valid() const override {
         return pimpl->valid() && (tell() < duration() && tell() >= 0ms);
     }
@@ -264,6 +292,8 @@ std::unique_ptr<PCMSource> Manager::impl::open(const web::uri& uri) {
             auto predicate = [&](const auto& provider) { return provider->supports_mime(*mime_type); };
             try {
                 for(const auto& provider : providers | boost::adaptors::filtered(predicate)) {
+                    if(uri.scheme() == "file")
+                        return provider->make_file_decoder(Input::uri_to_path(uri), std::move(is));
                     return provider->make_decoder(std::move(is));
                 }
             } catch(...) {
@@ -278,22 +308,59 @@ std::unique_ptr<PCMSource> Manager::impl::open(const web::uri& uri) {
 
 std::unique_ptr<PCMSource> Manager::open(const Core::Track& track) const {
     auto ret = pimpl->open(track.uri());
+    if(ret) {
+        auto index = track.seekIndex();
+        TRACE_LOG(logject) << "Opened " << track.uri().to_string() << " with " << index.size() << " seek points";
+        // called on whichever thread is decoding; the track shares its state with every copy
+        ret->set_seek_index(std::move(index), [ track, weak_pimpl = std::weak_ptr<impl>(pimpl) ](auto&& index) {
+            auto t = track;
+            t.seekIndex(index);
+            if(auto pimpl = weak_pimpl.lock())
+                pimpl->seekIndexed(t.uri(), t.start(), index);
+        });
+    }
     //    if(ret)
     //        ret = std::make_unique<TrackSource>(std::move(ret), track.start(), track.end());
     return ret;
 }
 
-template <typename Fun>
-static auto decode_all(const std::unique_ptr<PCMSource>& source, Fun&& fun) {
-    std::error_code ec;
-    std::array<char, 1024> data{{0}};
+size_t PCMSource::decode_float(float* out, size_t frames, std::error_code& ec) {
+    const auto as = getAudioSpecs();
+    thread_local std::vector<char> scratch; // only grows
+    if(scratch.size() < as.samples_to_bytes(frames))
+        scratch.resize(as.samples_to_bytes(frames));
+
+    PCMBuffer buf{scratch.data(), as.samples_to_bytes(frames)};
+    const auto n = as.bytes_to_samples(decode(buf, ec));
+    sample_converter{sample_format_from_bps(as.bps), sample_format::f32}.convert(scratch.data(), n * as.channels,
+                                                                                 out);
+    return n;
+}
+
+Signals::Decoder::SeekIndexed& Manager::getSeekIndexedSignal() noexcept {
+    return pimpl->seekIndexed;
+}
+
+void PCMSource::decode_all(const std::function<void(const char*, size_t)>& sink, unsigned, std::error_code& ec) {
+    seek(chrono::milliseconds{0});
+    std::vector<char> data(64 * 1024);
     while(!ec) {
         Melosic::PCMBuffer buf{data.data(), data.size()};
-        auto n = source->decode(buf, ec);
+        auto n = decode(buf, ec);
         assert(n <= data.size());
-        fun(data.begin(), std::next(data.begin(), n));
+        sink(data.data(), n);
     }
-    return ec;
+    if(ec == asio::error::eof)
+        ec.clear();
+}
+
+ConstPCMBuffer PCMSource::view(size_t, std::error_code&) {
+    return {};
+}
+
+std::unique_ptr<PCMSource> provider::make_file_decoder(const boost::filesystem::path&,
+                                                       std::unique_ptr<std::istream> in) const {
+    return make_decoder(std::move(in));
 }
 
 std::array<unsigned char, MD5_DIGEST_LENGTH> get_pcm_md5(std::unique_ptr<PCMSource> source) {
@@ -302,11 +369,14 @@ std::array<unsigned char, MD5_DIGEST_LENGTH> get_pcm_md5(std::unique_ptr<PCMSour
     if(!MD5_Init(&ctx)) {
         assert(false);
     }
-    std::error_code ec = decode_all(source, [&](auto first, auto last) {
-        if(!MD5_Update(&ctx, first, std::distance(first, last))) {
-            assert(false);
-        }
-    });
+    std::error_code ec;
+    source->decode_all(
+        [&](const char* data, size_t n) {
+            if(!MD5_Update(&ctx, data, n)) {
+                assert(false);
+            }
+        },
+        std::thread::hardware_concurrency(), ec);
     MD5_Final(checksum.data(), &ctx);
 
     return checksum;
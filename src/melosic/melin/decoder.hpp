@@ -35,6 +35,8 @@ namespace mpl = boost::mpl;
 
 #include <melosic/common/traits.hpp>
 #include <melosic/common/audiospecs.hpp>
+#include <melosic/common/seek_index.hpp>
+#include <melosic/common/signal_fwd.hpp>
 
 namespace Melosic {
 
@@ -52,6 +54,14 @@ class Kernel;
 }
 
 struct PCMBuffer;
+struct ConstPCMBuffer;
+
+namespace Signals {
+namespace Decoder {
+/// A decoder finished indexing the track at uri starting at the given time.
+using SeekIndexed = SignalCore<void(web::uri, chrono::milliseconds, seek_index)>;
+}
+}
 
 namespace Decoder {
 class PCMSource;
@@ -75,8 +85,11 @@ class Manager final {
     MELOSIC_EXPORT std::vector<Melosic::Core::Track> tracks(const web::uri&) const;
     MELOSIC_EXPORT std::vector<Melosic::Core::Track> tracks(const boost::filesystem::path&) const;
 
+    /// The returned decoder is given any seek index stored with the track.
     std::unique_ptr<PCMSource> open(const Core::Track&) const;
 
+    MELOSIC_EXPORT Signals::Decoder::SeekIndexed& getSeekIndexedSignal() noexcept;
+
   private:
     struct impl;
     std::shared_ptr<impl> pimpl;
@@ -91,6 +104,9 @@ struct provider {
 
     virtual bool supports_mime(std::string_view mime_type) const = 0;
     virtual std::unique_ptr<PCMSource> make_decoder(std::unique_ptr<std::istream> in) const = 0;
+    /// For a local file, opened as in. Providers may read it some other way, eg. mapped; the default decodes in.
+    virtual std::unique_ptr<PCMSource> make_file_decoder(const boost::filesystem::path& path,
+                                                         std::unique_ptr<std::istream> in) const;
     virtual bool verify(std::unique_ptr<std::istream> in) const = 0;
 };
 
@@ -104,8 +120,26 @@ class PCMSource {
     virtual chrono::milliseconds duration() const = 0;
     virtual AudioSpecs getAudioSpecs() const = 0;
     virtual size_t decode(PCMBuffer& buf, std::error_code& ec) = 0;
+    /// Decodes up to frames frames into out as interleaved float in [-1, 1). Returns frames decoded.
+    /// The default converts the output of decode(); decoders holding native integer samples should
+    /// override it to convert them directly.
+    virtual size_t decode_float(float* out, size_t frames, std::error_code& ec);
+    /// Decodes the whole stream from its start for offline work such as checksumming or analysis, handing sink
+    /// consecutive runs of the PCM decode() would give. Decoders able to split their stream may decode it on up to
+    /// threads threads; the default decodes sequentially. ec is left clear on reaching the end.
+    /// The position afterwards is unspecified; seek() before decoding again.
+    virtual void decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads,
+                            std::error_code& ec);
+    /// For sources already holding their PCM in memory as decode() would give it: up to max_bytes of it in place,
+    /// advancing as decode() would. The view is valid for the life of the source.
+    /// The default gives an empty view without advancing; decode() instead.
+    virtual ConstPCMBuffer view(size_t max_bytes, std::error_code& ec);
     virtual bool valid() const = 0;
     virtual void reset() = 0;
+    /// Seek points from an earlier decode of the same stream, possibly empty.
+    /// Decoders which index as they decode call indexed with their grown index on reaching the end of the stream.
+    virtual void set_seek_index(seek_index, std::function<void(const seek_index&)> indexed) {
+    }
 };
 
 } // namespace Decoder
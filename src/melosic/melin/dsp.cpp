@@ -0,0 +1,170 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+using mutex = std::mutex;
+using unique_lock = std::unique_lock<mutex>;
+
+#include <melosic/melin/logging.hpp>
+#include <melosic/common/typeid.hpp>
+
+#include "dsp.hpp"
+
+namespace Melosic {
+namespace DSP {
+
+Logger::Logger logject{logging::keywords::channel = "DSP::Manager"};
+
+struct Manager::impl {
+    mutex mu;
+    std::vector<std::shared_ptr<provider>> providers;
+};
+
+Manager::Manager() : pimpl(std::make_shared<impl>()) {
+}
+
+Manager::~Manager() {
+}
+
+void Manager::add_provider(std::shared_ptr<provider> provider) {
+    unique_lock l(pimpl->mu);
+    TRACE_LOG(logject) << "Adding provider " << provider->name();
+    pimpl->providers.emplace_back(std::move(provider));
+}
+
+chain Manager::make_chain(const std::vector<std::string>& names) const {
+    unique_lock l(pimpl->mu);
+    chain c;
+    for(const auto& name : names) {
+        auto it = std::find_if(pimpl->providers.begin(), pimpl->providers.end(),
+                               [&](auto&& provider) { return provider->name() == name; });
+        if(it == pimpl->providers.end()) {
+            ERROR_LOG(logject) << "No DSP provider named " << name;
+            continue;
+        }
+        auto proc = (*it)->make_processor();
+        if(!proc->supports(sample_format::f32)) {
+            ERROR_LOG(logject) << "DSP provider " << name << " doesn't support float";
+            continue;
+        }
+        c.add(name, std::move(proc));
+    }
+    return c;
+}
+
+struct chain::impl {
+    struct stage {
+        stage(std::string name, std::unique_ptr<processor> proc) : name(std::move(name)), proc(std::move(proc)) {
+        }
+
+        std::string name;
+        std::unique_ptr<processor> proc;
+        std::atomic<uint64_t> blocks{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+    };
+
+    // stages hold atomics so are never moved
+    std::vector<std::unique_ptr<stage>> stages;
+    AudioSpecs specs;
+    size_t max_frames = 0;
+};
+
+chain::chain() : pimpl(std::make_unique<impl>()) {
+}
+
+chain::~chain() {
+}
+
+chain::chain(chain&&) noexcept = default;
+chain& chain::operator=(chain&&) noexcept = default;
+
+void chain::add(std::string name, std::unique_ptr<processor> proc) {
+    assert(proc && proc->supports(sample_format::f32));
+    pimpl->stages.emplace_back(std::make_unique<impl::stage>(std::move(name), std::move(proc)));
+    pimpl->max_frames = 0; // needs preparing
+}
+
+bool chain::empty() const noexcept {
+    return pimpl->stages.empty();
+}
+
+void chain::prepare(AudioSpecs as, size_t max_frames) {
+    pimpl->specs = as;
+    pimpl->max_frames = max_frames;
+    for(auto&& stage : pimpl->stages)
+        stage->proc->prepare(as, sample_format::f32, max_frames);
+    TRACE_LOG(logject) << "DSP chain of " << pimpl->stages.size() << " stages prepared; " << as;
+}
+
+bool chain::prepared(AudioSpecs as, size_t max_frames) const noexcept {
+    return pimpl->max_frames == max_frames && pimpl->specs == as;
+}
+
+size_t chain::max_frames() const noexcept {
+    return pimpl->max_frames;
+}
+
+void chain::process(float* samples, size_t frames) noexcept {
+    assert(frames <= pimpl->max_frames);
+    for(auto&& stage : pimpl->stages) {
+        const auto start = chrono::steady_clock::now();
+        stage->proc->process(samples, frames);
+        const uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+        stage->blocks.fetch_add(1, std::memory_order_relaxed);
+        stage->total_ns.fetch_add(ns, std::memory_order_relaxed);
+        auto max = stage->max_ns.load(std::memory_order_relaxed);
+        while(ns > max && !stage->max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+            ;
+    }
+}
+
+size_t chain::latency() const noexcept {
+    size_t latency = 0;
+    for(auto&& stage : pimpl->stages)
+        latency += stage->proc->latency();
+    return latency;
+}
+
+size_t chain::tail() const noexcept {
+    size_t tail = 0;
+    for(auto&& stage : pimpl->stages)
+        tail += stage->proc->tail();
+    return tail;
+}
+
+void chain::reset() noexcept {
+    for(auto&& stage : pimpl->stages)
+        stage->proc->reset();
+}
+
+std::vector<chain::stage_timing> chain::timings() const {
+    std::vector<stage_timing> timings;
+    timings.reserve(pimpl->stages.size());
+    for(auto&& stage : pimpl->stages)
+        timings.push_back({stage->name, stage->blocks.load(std::memory_order_relaxed),
+                           chrono::nanoseconds(stage->total_ns.load(std::memory_order_relaxed)),
+                           chrono::nanoseconds(stage->max_ns.load(std::memory_order_relaxed))});
+    return timings;
+}
+
+} // namespace DSP
+} // namespace Melosic
@@ -0,0 +1,146 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef MELOSIC_DSPMANAGER_HPP
+#define MELOSIC_DSPMANAGER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+namespace chrono = std::chrono;
+
+#include <melosic/common/common.hpp>
+#include <melosic/common/audiospecs.hpp>
+#include <melosic/common/sample_convert.hpp>
+
+namespace Melosic {
+
+namespace Core {
+class Kernel;
+}
+
+namespace DSP {
+
+class processor;
+class chain;
+struct provider;
+
+class Manager final {
+    Manager();
+    friend class Core::Kernel;
+
+  public:
+    ~Manager();
+
+    Manager(const Manager&) = delete;
+    Manager& operator=(const Manager&) = delete;
+    Manager(Manager&&) = delete;
+    Manager& operator=(Manager&&) = delete;
+
+    void add_provider(std::shared_ptr<provider>);
+
+    /// Processors from the named providers, in order. Unknown names, and processors without float support, are
+    /// logged and skipped.
+    MELOSIC_EXPORT chain make_chain(const std::vector<std::string>& names) const;
+
+  private:
+    struct impl;
+    std::shared_ptr<impl> pimpl;
+};
+
+struct provider {
+    virtual ~provider() {
+    }
+
+    virtual std::string_view name() const = 0;
+    virtual std::unique_ptr<processor> make_processor() const = 0;
+};
+
+/// A single processing stage, working in place on interleaved samples.
+///
+/// prepare() is where all allocation happens; process() must neither allocate nor block.
+class processor {
+  public:
+    virtual ~processor() {
+    }
+
+    virtual bool supports(sample_format) const noexcept = 0;
+
+    /// Called before the first block and whenever the specs or format change.
+    /// Blocks passed to process() are never longer than max_frames.
+    virtual void prepare(AudioSpecs, sample_format, size_t max_frames) = 0;
+
+    virtual void process(void* samples, size_t frames) noexcept = 0;
+
+    /// Frames of delay added by this stage.
+    virtual size_t latency() const noexcept {
+        return 0;
+    }
+    /// Frames of output still to come after input ends, eg. reverb.
+    virtual size_t tail() const noexcept {
+        return 0;
+    }
+    /// Drop any internal state, eg. after a seek.
+    virtual void reset() noexcept {
+    }
+};
+
+/// Ordered processors, working in place on interleaved float.
+class MELOSIC_EXPORT chain final {
+  public:
+    struct stage_timing {
+        std::string name;
+        uint64_t blocks;
+        chrono::nanoseconds total;
+        chrono::nanoseconds max;
+    };
+
+    chain();
+    ~chain();
+    chain(chain&&) noexcept;
+    chain& operator=(chain&&) noexcept;
+
+    /// The processor must support float.
+    void add(std::string name, std::unique_ptr<processor>);
+
+    bool empty() const noexcept;
+
+    void prepare(AudioSpecs, size_t max_frames);
+    bool prepared(AudioSpecs, size_t max_frames) const noexcept;
+
+    size_t max_frames() const noexcept;
+
+    /// Runs every stage over frames in place. frames must not exceed max_frames().
+    void process(float* samples, size_t frames) noexcept;
+
+    size_t latency() const noexcept;
+    size_t tail() const noexcept;
+    void reset() noexcept;
+
+    /// Cumulative per-stage timings; safe to call while another thread processes.
+    std::vector<stage_timing> timings() const;
+
+  private:
+    struct impl;
+    std::unique_ptr<impl> pimpl;
+};
+
+} // namespace DSP
+} // namespace Melosic
+
+#endif // MELOSIC_DSPMANAGER_HPP
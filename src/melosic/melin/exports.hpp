@@ -99,7 +99,8 @@ enum class Type {
     inputDevice = 0b0001000,
     utility = 0b0010000,
     service = 0b0100000,
-    gui = 0b1000000
+    gui = 0b1000000,
+    dsp = 0b10000000
 };
 
 constexpr Type operator|(Type a, Type b) noexcept {
@@ -27,6 +27,7 @@
 #include <melosic/melin/plugin.hpp>
 #include <melosic/melin/input.hpp>
 #include <melosic/melin/decoder.hpp>
+#include <melosic/melin/dsp.hpp>
 #include <melosic/melin/output.hpp>
 #include <melosic/melin/encoder.hpp>
 #include <melosic/melin/playlist.hpp>
@@ -60,7 +61,7 @@ struct Kernel::impl {
           outman(new Output::Manager{confman, audio_io_service}),
           audio_null_worker(new null_worker_type(audio_io_service.get_executor())),
           audio_io_thread(io_thread_runner, std::ref(audio_io_service)), inman(new Input::Manager{}),
-          decman(new Decoder::Manager{inman, plugman}), encman(new Encoder::Manager{}),
+          decman(new Decoder::Manager{inman, plugman}), dspman(new DSP::Manager{}), encman(new Encoder::Manager{}),
           libman(new Library::Manager{confman, decman, plugman}), playlistman(new Melosic::Playlist::Manager{}),
           io_service(), null_worker(new null_worker_type(io_service.get_executor())),
           io_thread(io_thread_runner, std::ref(io_service)) {
@@ -83,6 +84,7 @@ struct Kernel::impl {
     boost::scoped_thread<> audio_io_thread;
     std::shared_ptr<Input::Manager> inman;
     std::shared_ptr<Decoder::Manager> decman;
+    std::shared_ptr<DSP::Manager> dspman;
     std::shared_ptr<Encoder::Manager> encman;
     std::shared_ptr<Library::Manager> libman;
     std::shared_ptr<Melosic::Playlist::Manager> playlistman;
@@ -115,6 +117,10 @@ std::shared_ptr<Decoder::Manager> Kernel::getDecoderManager() const {
     return pimpl->decman;
 }
 
+std::shared_ptr<DSP::Manager> Kernel::getDSPManager() const {
+    return pimpl->dspman;
+}
+
 std::shared_ptr<Output::Manager> Kernel::getOutputManager() const {
     return pimpl->outman;
 }
@@ -37,6 +37,9 @@ class Manager;
 namespace Decoder {
 class Manager;
 }
+namespace DSP {
+class Manager;
+}
 namespace Output {
 class Manager;
 }
@@ -70,6 +73,7 @@ class MELOSIC_EXPORT Kernel final {
     std::shared_ptr<Plugin::Manager> getPluginManager() const;
     std::shared_ptr<Input::Manager> getInputManager() const;
     std::shared_ptr<Decoder::Manager> getDecoderManager() const;
+    std::shared_ptr<DSP::Manager> getDSPManager() const;
     std::shared_ptr<Output::Manager> getOutputManager() const;
     std::shared_ptr<Encoder::Manager> getEncoderManager() const;
     std::shared_ptr<Melosic::Playlist::Manager> getPlaylistManager() const;
@@ -112,6 +112,7 @@ struct Manager::impl : std::enable_shared_from_this<impl> {
     void remove_prefix(const fs::path& dir);
     void update(const fs::path& file);
     void update(const web::uri& uri);
+    void seekIndexedSlot(web::uri uri, chrono::milliseconds start, seek_index index);
     std::vector<jbson::document> query(const jbson::document& qdoc);
 
     std::shared_ptr<Decoder::Manager> decman;
@@ -157,6 +158,7 @@ Manager::impl::impl(const std::shared_ptr<Config::Manager>& confman, const std::
     m_db.create_collection("tracks");
 
     confman->getLoadedSignal().connect(&impl::loadedSlot, this);
+    m_signal_connections.emplace_back(decman->getSeekIndexedSignal().connect(&impl::seekIndexedSlot, this));
 
     added.connect([this](web::uri uri) { LOG(logject) << "Media added to library: " << uri.to_string(); });
     removed.connect([this](web::uri uri) { LOG(logject) << "Media removed from library: " << uri.to_string(); });
@@ -576,6 +578,32 @@ void Manager::impl::update(const web::uri& uri) {
     ERROR_LOG(logject) << "update library entry not implemented";
 }
 
+void Manager::impl::seekIndexedSlot(web::uri uri, chrono::milliseconds start, seek_index index) {
+    // comes from a decoding thread; don't hold it up with db writes
+    asio::post([ this, self = shared_from_this(), uri, start, index = std::move(index) ] {
+        try {
+            auto coll = m_db.get_collection("tracks");
+            if(!coll)
+                return;
+            ejdb::unique_transaction trans(coll.transaction());
+
+            auto qdoc = jbson::document(jbson::builder("location", uri.to_string())(
+                "start", jbson::element_type::int64_element, start.count())(
+                "$set", jbson::builder("seek index", jbson::element_type::document_element,
+                                       Core::seek_index_bson(index))));
+            auto qry = m_db.create_query(qdoc.data());
+
+            auto n = coll.execute_query<ejdb::query_search_mode::count_only>(qry);
+            TRACE_LOG(logject) << "Stored " << index.size() << " seek points for " << n << " tracks at "
+                               << uri.to_string();
+        } catch(std::runtime_error& e) {
+            ERROR_LOG(logject) << "Error storing seek index: " << e.what();
+        } catch(...) {
+            ERROR_LOG(logject) << "Error storing seek index: " << boost::current_exception_diagnostic_information();
+        }
+    });
+}
+
 std::vector<jbson::document> Manager::impl::query(const jbson::document& qdoc) {
     auto q = m_db.create_query(qdoc.data()).set_hints(R"({ "$orderby": { "location": 1 } })"_json_doc.data());
     assert(q);
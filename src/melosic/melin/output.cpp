@@ -16,6 +16,8 @@
 **************************************************************************/
 
 #include <map>
+#include <deque>
+#include <algorithm>
 #include <thread>
 #include <mutex>
 using std::mutex;
@@ -48,6 +50,11 @@ class Manager::impl {
     impl(const std::shared_ptr<Config::Manager>& confman, asio::io_service& io_service) : io_service(io_service) {
         conf.putNode("output device", "default"s);
         conf.putNode("buffer time", 1000);
+        // milliseconds from writing to the device to hearing it; small for responsive seeking, large to save power
+        conf.putNode("latency", static_cast<int64_t>(200));
+        // names of outputs to run in low power mode: long device buffers, decoding in bursts
+        conf.putNode("low power outputs", std::vector<Config::VarType>{});
+        conf.putNode("low power latency", static_cast<int64_t>(2000));
         confman->getLoadedSignal().connect(&impl::loadedSlot, this);
     }
 
@@ -74,6 +81,8 @@ class Manager::impl {
                     LOG(logject) << "Chosen output same as current. Not reinitialising.";
                 else
                     setASIOSink(sn);
+            } else if(key == "latency" || key == "low power outputs" || key == "low power latency") {
+                // applied by the player when it next prepares the device
             } else
                 ERROR_LOG(logject) << "Config: Unknown key: " << key;
         } catch(boost::bad_get&) {
@@ -95,9 +104,17 @@ class Manager::impl {
     }
 
     std::unique_ptr<AudioIO::AudioOutputBase> createASIOSink() {
-        TRACE_LOG(logject) << "Creating player sink " << sinkName;
         lock_guard l(mu);
 
+        auto warm = findWarmSink(sinkName);
+        if(warm != warmSinks.end()) {
+            TRACE_LOG(logject) << "Reusing warm player sink " << sinkName;
+            auto sink = std::move(warm->second);
+            warmSinks.erase(warm);
+            return sink;
+        }
+
+        TRACE_LOG(logject) << "Creating player sink " << sinkName;
         auto it = asioOutputFactories.find(sinkName);
 
         if(it == asioOutputFactories.end()) {
@@ -108,6 +125,25 @@ class Manager::impl {
         return it->second(io_service, sinkName);
     }
 
+    void keepASIOSink(const std::string& name, std::unique_ptr<AudioIO::AudioOutputBase> sink) {
+        if(!sink)
+            return;
+        // closed once mu is released
+        std::unique_ptr<AudioIO::AudioOutputBase> closing;
+        lock_guard l(mu);
+        if(findWarmSink(name) != warmSinks.end()) {
+            LOG(logject) << "Already holding a warm sink " << name << "; closing the other";
+            closing = std::move(sink);
+            return;
+        }
+        if(warmSinks.size() >= maxWarmSinks) {
+            TRACE_LOG(logject) << "Closing warm sink " << warmSinks.front().first;
+            closing = std::move(warmSinks.front().second);
+            warmSinks.pop_front();
+        }
+        warmSinks.emplace_back(name, std::move(sink));
+    }
+
     void setASIOSink(std::string sinkname) {
         unique_lock l(mu);
         sinkName = std::move(sinkname);
@@ -120,10 +156,19 @@ class Manager::impl {
     }
 
   private:
+    using warm_sinks = std::deque<std::pair<std::string, std::unique_ptr<AudioIO::AudioOutputBase>>>;
+
+    warm_sinks::iterator findWarmSink(const std::string& name) {
+        return std::find_if(warmSinks.begin(), warmSinks.end(), [&](auto&& warm) { return warm.first == name; });
+    }
+
     mutex mu;
     asio::io_service& io_service;
     std::string sinkName;
     std::map<device_descriptor, ASIOFactory> asioOutputFactories;
+    // stopped but still open, oldest first. each holds its device open, so only a few are kept
+    warm_sinks warmSinks;
+    static constexpr size_t maxWarmSinks = 4;
     Config::Conf conf{"Output"};
     PlayerSinkChanged playerSinkChanged;
     Logger::Logger logject{logging::keywords::channel = "Output::Manager"};
@@ -150,6 +195,10 @@ std::unique_ptr<AudioIO::AudioOutputBase> Manager::createASIOSink() const {
     return pimpl->createASIOSink();
 }
 
+void Manager::keepASIOSink(const std::string& name, std::unique_ptr<AudioIO::AudioOutputBase> sink) const {
+    pimpl->keepASIOSink(name, std::move(sink));
+}
+
 Signals::Output::PlayerSinkChanged& Manager::getPlayerSinkChangedSignal() const {
     return pimpl->getPlayerSinkChangedSignal();
 }
@@ -69,7 +69,11 @@ class Manager final {
 
     const std::string& currentSinkName() const;
 
+    /// The current sink, warm from keepASIOSink() where possible, otherwise newly created.
     std::unique_ptr<AudioIO::AudioOutputBase> createASIOSink() const;
+    /// Holds a stopped sink open for the next createASIOSink() of the same name, saving a reopen and renegotiation.
+    /// Only one is held per name and a few in all, the longest held closed first.
+    void keepASIOSink(const std::string& name, std::unique_ptr<AudioIO::AudioOutputBase> sink) const;
     Signals::Output::PlayerSinkChanged& getPlayerSinkChangedSignal() const;
 
   private:
@@ -84,6 +88,8 @@ enum class DeviceState {
     Paused,
     Stopped,
     Initial,
+    /// the device is being opened and negotiated, after which it plays
+    Preparing,
 };
 
 struct device_descriptor {
@@ -41,6 +41,7 @@ namespace fs = boost::filesystem;
 #include <melosic/common/signal.hpp>
 #include <melosic/common/bit_flag_iterator.hpp>
 #include <melosic/melin/decoder.hpp>
+#include <melosic/melin/dsp.hpp>
 
 #include "plugin.hpp"
 
@@ -81,6 +82,12 @@ struct Plugin : std::enable_shared_from_this<Plugin> {
                         shared_from_this(), get_typed_alias<Decoder::provider*()>("decoder_provider")()));
                     break;
                 }
+                case Type::dsp: {
+                    std::shared_ptr<DSP::Manager> dspman = kernel.getDSPManager();
+                    dspman->add_provider(std::shared_ptr<DSP::provider>(
+                        shared_from_this(), get_typed_alias<DSP::provider*()>("dsp_provider")()));
+                    break;
+                }
                 case Type::encoder:
                 case Type::outputDevice:
                 case Type::inputDevice:
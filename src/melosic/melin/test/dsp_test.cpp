@@ -0,0 +1,131 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <vector>
+
+#include <catch.hpp>
+
+#include <melosic/melin/dsp.hpp>
+using namespace Melosic;
+
+namespace {
+
+struct gain final : DSP::processor {
+    explicit gain(float g, size_t latency = 0) : g(g), m_latency(latency) {
+    }
+
+    bool supports(sample_format fmt) const noexcept override {
+        return fmt == sample_format::f32;
+    }
+    void prepare(AudioSpecs as, sample_format, size_t max_frames) override {
+        channels = as.channels;
+        prepared_frames = max_frames;
+    }
+    void process(void* samples, size_t frames) noexcept override {
+        auto ptr = static_cast<float*>(samples);
+        for(size_t i = 0; i < frames * channels; ++i)
+            ptr[i] *= g;
+    }
+    size_t latency() const noexcept override {
+        return m_latency;
+    }
+
+    float g;
+    size_t m_latency;
+    unsigned channels = 0;
+    size_t prepared_frames = 0;
+};
+
+struct invert final : DSP::processor {
+    bool supports(sample_format fmt) const noexcept override {
+        return fmt == sample_format::f32 || fmt == sample_format::s16;
+    }
+    void prepare(AudioSpecs as, sample_format fmt, size_t) override {
+        channels = as.channels;
+        format = fmt;
+    }
+    void process(void* samples, size_t frames) noexcept override {
+        if(format == sample_format::s16) {
+            auto ptr = static_cast<int16_t*>(samples);
+            for(size_t i = 0; i < frames * channels; ++i)
+                ptr[i] = -ptr[i];
+        } else {
+            auto ptr = static_cast<float*>(samples);
+            for(size_t i = 0; i < frames * channels; ++i)
+                ptr[i] = -ptr[i];
+        }
+    }
+    size_t tail() const noexcept override {
+        return 10;
+    }
+
+    unsigned channels = 0;
+    sample_format format = sample_format::f32;
+};
+
+} // namespace
+
+TEST_CASE("DSPChainPrepare") {
+    const AudioSpecs as{2, 16, 44100};
+
+    DSP::chain c;
+    CHECK(c.empty());
+    auto i = std::make_unique<invert>();
+    auto i_ptr = i.get();
+    c.add("invert", std::move(i));
+    CHECK(!c.empty());
+    CHECK(!c.prepared(as, 64));
+
+    // stages always work in float, whatever the output's format
+    c.prepare(as, 64);
+    CHECK(i_ptr->format == sample_format::f32);
+    CHECK(c.prepared(as, 64));
+    CHECK(!c.prepared(as, 128));
+    CHECK(!c.prepared(AudioSpecs{2, 16, 48000}, 64));
+
+    // added stages need preparing
+    c.add("gain", std::make_unique<gain>(0.5f));
+    CHECK(!c.prepared(as, 64));
+}
+
+TEST_CASE("DSPChainProcess") {
+    const AudioSpecs as{2, 32, 48000};
+
+    DSP::chain c;
+    auto g = std::make_unique<gain>(0.5f, 3);
+    auto g_ptr = g.get();
+    c.add("gain", std::move(g));
+    c.add("invert", std::make_unique<invert>());
+    c.prepare(as, 4);
+    CHECK(g_ptr->prepared_frames == 4u);
+    CHECK(c.latency() == 3u);
+    CHECK(c.tail() == 10u);
+
+    std::vector<float> samples{1.0f, -1.0f, 0.5f, 0.25f};
+    c.process(samples.data(), 2);
+    CHECK(samples == (std::vector<float>{-0.5f, 0.5f, -0.25f, -0.125f}));
+    c.process(samples.data(), 1);
+
+    const auto timings = c.timings();
+    REQUIRE(timings.size() == 2u);
+    CHECK(timings[0].name == "gain");
+    CHECK(timings[1].name == "invert");
+    for(auto&& t : timings) {
+        CHECK(t.blocks == 2u);
+        CHECK(t.max <= t.total);
+    }
+}
@@ -18,6 +18,11 @@
 #include <poll.h>
 
 #include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+using lock_guard = std::lock_guard<std::mutex>;
 using namespace std::literals;
 
 #include "alsa_output_service_impl.hpp"
@@ -41,7 +46,20 @@ static constexpr std::array<uint8_t, 5> bpss{{8, 16, 24, 24, 32}};
 Melosic::Config::Conf conf{"ALSA"};
 snd_pcm_uframes_t frames = 1024;
 bool resample = false;
-auto buf_time_msecs = 1000ms;
+/// write straight into the device's buffer where it allows, rather than through snd_pcm_writei
+bool use_mmap = true;
+/// periods per device buffer; the device is topped up each time one plays out
+constexpr snd_pcm_uframes_t periods = 4;
+
+/// what negotiating a key's hw params settled on, so reopening the device needn't negotiate again
+struct hw_setup {
+    Melosic::AudioSpecs specs;
+    bool mmap;
+    Melosic::AudioIO::output_buffering buffering;
+    std::unique_ptr<snd_pcm_hw_params_t, decltype(&snd_pcm_hw_params_free)> params;
+};
+std::mutex hw_cache_mu;
+std::map<output_service_impl::hw_key, hw_setup> hw_cache;
 
 output_service_impl::output_service_impl(asio::io_service& service) : base_t(service), m_asio_fd(service) {
 }
@@ -56,9 +74,16 @@ void output_service_impl::assign(Melosic::Output::device_descriptor dev_name, st
 }
 
 void output_service_impl::destroy() {
+    if(m_prepare_thread.joinable())
+        m_prepare_thread.join();
     std::error_code ec;
-    if(m_pdh != nullptr)
+    if(m_pdh != nullptr) {
         stop(ec);
+        m_asio_fd.release();
+        snd_pcm_close(m_pdh);
+        m_pdh = nullptr;
+        m_installed = Melosic::nullopt;
+    }
     if(m_params != nullptr)
         snd_pcm_hw_params_free(m_params);
 }
@@ -69,7 +94,6 @@ void output_service_impl::cancel(std::error_code& ec) {
 }
 
 Melosic::AudioSpecs output_service_impl::prepare(Melosic::AudioSpecs as, std::error_code& ec) {
-    m_current_specs = as;
     m_state = Melosic::Output::DeviceState::Error;
     if((m_pdh == nullptr) &&
        (ec = {snd_pcm_open(&m_pdh, m_name.c_str(), SND_PCM_STREAM_PLAYBACK, m_non_blocking), alsa_category}))
@@ -78,17 +102,133 @@ Melosic::AudioSpecs output_service_impl::prepare(Melosic::AudioSpecs as, std::er
     if((m_params == nullptr) && (ec = {snd_pcm_hw_params_malloc(&m_params), alsa_category}))
         return m_current_specs;
 
+    const hw_key key{m_name, as.channels, as.bps, as.sample_rate, m_latency.count(), use_mmap, resample};
+    if(m_installed != key) {
+        // hw_params can't change under a running stream
+        if(snd_pcm_state(m_pdh) != SND_PCM_STATE_OPEN && (ec = {snd_pcm_drop(m_pdh), alsa_category}))
+            return m_current_specs;
+        m_installed = Melosic::nullopt;
+        lock_guard l(hw_cache_mu);
+        auto cached = hw_cache.find(key);
+        if(cached != hw_cache.end()) {
+            TRACE_LOG(logject) << "Using cached hw params for " << as;
+            snd_pcm_hw_params_copy(m_params, cached->second.params.get());
+            if((ec = {snd_pcm_hw_params(m_pdh, m_params), alsa_category})) {
+                // the device may have changed since, eg. replugged or reconfigured
+                TRACE_LOG(logject) << "Cached hw params rejected: " << ec.message() << ". Negotiating afresh";
+                hw_cache.erase(cached);
+                cached = hw_cache.end();
+                ec.clear();
+            } else {
+                m_current_specs = cached->second.specs;
+                m_mmap = cached->second.mmap;
+                m_buffering = cached->second.buffering;
+            }
+        }
+        if(cached == hw_cache.end()) {
+            negotiate(as, ec);
+            if(ec)
+                return m_current_specs;
+            hw_setup setup{m_current_specs, m_mmap, m_buffering, {nullptr, &snd_pcm_hw_params_free}};
+            snd_pcm_hw_params_t* params = nullptr;
+            if(snd_pcm_hw_params_malloc(&params) == 0) {
+                setup.params.reset(params);
+                snd_pcm_hw_params_copy(params, m_params);
+                hw_cache.emplace(key, std::move(setup));
+            }
+        }
+        m_installed = key;
+    } else
+        TRACE_LOG(logject) << "hw params already installed for " << as;
+    const snd_pcm_uframes_t period_frames = m_buffering.period_frames;
+
+    snd_pcm_sw_params_t* sw_params;
+    snd_pcm_sw_params_alloca(&sw_params);
+    if((ec = {snd_pcm_sw_params_current(m_pdh, sw_params), alsa_category}))
+        return m_current_specs;
+    // wake for a whole period of space rather than every frame
+    if((ec = {snd_pcm_sw_params_set_avail_min(m_pdh, sw_params, period_frames), alsa_category}))
+        return m_current_specs;
+    // start as soon as a period is queued, so short buffers aren't held back waiting to fill
+    if((ec = {snd_pcm_sw_params_set_start_threshold(m_pdh, sw_params, period_frames), alsa_category}))
+        return m_current_specs;
+    if((ec = {snd_pcm_sw_params(m_pdh, sw_params), alsa_category}))
+        return m_current_specs;
+
+    auto pcount = snd_pcm_poll_descriptors_count(m_pdh);
+    if((pcount < 0) && (ec = {pcount, alsa_category}))
+        return m_current_specs;
+
+    m_pfds.clear();
+    m_pfds.resize(pcount);
+
+    auto n = snd_pcm_poll_descriptors(m_pdh, m_pfds.data(), m_pfds.size());
+    TRACE_LOG(logject) << "no. poll descriptors: " << m_pfds.size();
+    TRACE_LOG(logject) << "no. poll descriptors filled: " << n;
+    assert(!m_pfds.empty());
+    if((n < 0) && (ec = {n, alsa_category}))
+        return m_current_specs;
+
+    m_mangled_revents = static_cast<bool>(m_pfds.data()->events & POLLIN);
+
+    // the descriptor belongs to the still open handle
+    if(m_asio_fd.is_open()) {
+        m_asio_fd.cancel();
+        m_asio_fd.release();
+    }
+    if(m_asio_fd.assign(m_pfds.data()->fd, ec))
+        return m_current_specs;
+
+    {
+        auto events = m_pfds.data()->events;
+        if(events & POLLERR)
+            TRACE_LOG(logject) << "events: POLLERR";
+        if(events & POLLOUT)
+            TRACE_LOG(logject) << "events: POLLOUT";
+        if(events & POLLIN)
+            TRACE_LOG(logject) << "events: POLLIN";
+        if(events & POLLPRI)
+            TRACE_LOG(logject) << "events: POLLPRI";
+        if(events & POLLRDHUP)
+            TRACE_LOG(logject) << "events: POLLRDHUP";
+        if(events & POLLHUP)
+            TRACE_LOG(logject) << "events: POLLHUP";
+        if(events & POLLNVAL)
+            TRACE_LOG(logject) << "events: POLLNVAL";
+        if(events & POLLRDNORM)
+            TRACE_LOG(logject) << "events: POLLRDNORM";
+        if(events & POLLRDBAND)
+            TRACE_LOG(logject) << "events: POLLRDBAND";
+        if(events & POLLWRNORM)
+            TRACE_LOG(logject) << "events: POLLWRNORM";
+        if(events & POLLWRBAND)
+            TRACE_LOG(logject) << "events: POLLWRBAND";
+    }
+    m_pfds.clear();
+
+    m_state = Melosic::Output::DeviceState::Ready;
+    assert(!ec);
+    TRACE_LOG(logject) << "internal state after prepare: " << snd_pcm_state_name(snd_pcm_state(m_pdh));
+
+    return m_current_specs;
+}
+
+void output_service_impl::negotiate(Melosic::AudioSpecs as, std::error_code& ec) {
+    m_current_specs = as;
     snd_pcm_hw_params_any(m_pdh, m_params);
 
-    snd_pcm_hw_params_set_access(m_pdh, m_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    m_mmap = use_mmap && snd_pcm_hw_params_set_access(m_pdh, m_params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+    if(!m_mmap && (ec = {snd_pcm_hw_params_set_access(m_pdh, m_params, SND_PCM_ACCESS_RW_INTERLEAVED), alsa_category}))
+        return;
+    TRACE_LOG(logject) << "access: " << (m_mmap ? "mmap" : "read/write") << " interleaved";
 
     if((ec = {snd_pcm_hw_params_set_channels(m_pdh, m_params, m_current_specs.channels), alsa_category}))
-        return m_current_specs;
+        return;
     int dir = 0;
     if((ec = {snd_pcm_hw_params_set_rate_resample(m_pdh, m_params, resample), alsa_category}))
-        return m_current_specs;
+        return;
     if((ec = {snd_pcm_hw_params_set_rate_near(m_pdh, m_params, &m_current_specs.sample_rate, &dir), alsa_category}))
-        return m_current_specs;
+        return;
     if(as.sample_rate != m_current_specs.sample_rate)
         WARN_LOG(logject) << "Sample rate: " << as.sample_rate << " not supported. Using "
                           << m_current_specs.sample_rate;
@@ -141,98 +281,33 @@ Melosic::AudioSpecs output_service_impl::prepare(Melosic::AudioSpecs as, std::er
             }
             if(rp == formats.rend()) {
                 ec = std::make_error_code(std::errc::invalid_argument);
-                return m_current_specs;
+                return;
             }
         }
     }
 
     if((ec = {snd_pcm_hw_params_set_format(m_pdh, m_params, fmt), alsa_category}))
-        return m_current_specs;
-
-    snd_pcm_uframes_t min_frames;
-    snd_pcm_hw_params_get_period_size_min(m_params, &min_frames, &dir);
-    if(min_frames == 0)
-        min_frames = 1;
-    TRACE_LOG(logject) << "min frames: " << min_frames;
-
-    snd_pcm_uframes_t min_buf;
-    snd_pcm_hw_params_get_buffer_size_min(m_params, &min_buf);
-    if(min_buf == 0)
-        min_buf = 1;
-    TRACE_LOG(logject) << "min buf: " << min_buf;
-
-    snd_pcm_uframes_t buf = m_current_specs.time_to_bytes(buf_time_msecs);
-    TRACE_LOG(logject) << "buf: " << buf;
-    if((ec = {snd_pcm_hw_params_set_buffer_size_near(m_pdh, m_params, &buf), alsa_category}))
-        return m_current_specs;
-
-    snd_pcm_hw_params_get_buffer_size(m_params, &buf);
-    TRACE_LOG(logject) << "set buf: " << buf;
+        return;
 
-    snd_pcm_uframes_t frames = buf / (min_buf / min_frames);
-    TRACE_LOG(logject) << "frames = buf/(min_buf/min_frames): " << frames;
-    if((ec = {snd_pcm_hw_params_set_period_size_near(m_pdh, m_params, &frames, &dir), alsa_category}))
-        return m_current_specs;
-    TRACE_LOG(logject) << "set frames per period: " << frames;
+    // the buffer holds the latency target; the device may round either size to what it supports
+    snd_pcm_uframes_t buffer_frames = std::max<snd_pcm_uframes_t>(m_current_specs.time_to_samples(m_latency), periods);
+    if((ec = {snd_pcm_hw_params_set_buffer_size_near(m_pdh, m_params, &buffer_frames), alsa_category}))
+        return;
+    snd_pcm_uframes_t period_frames = buffer_frames / periods;
+    if((ec = {snd_pcm_hw_params_set_period_size_near(m_pdh, m_params, &period_frames, &dir), alsa_category}))
+        return;
 
     if((ec = {snd_pcm_hw_params(m_pdh, m_params), alsa_category}))
-        return m_current_specs;
-
-    auto pcount = snd_pcm_poll_descriptors_count(m_pdh);
-    if((pcount < 0) && (ec = {pcount, alsa_category}))
-        return m_current_specs;
-
-    m_pfds.clear();
-    m_pfds.resize(pcount);
-
-    auto n = snd_pcm_poll_descriptors(m_pdh, m_pfds.data(), m_pfds.size());
-    TRACE_LOG(logject) << "no. poll descriptors: " << m_pfds.size();
-    TRACE_LOG(logject) << "no. poll descriptors filled: " << n;
-    assert(!m_pfds.empty());
-    if((n < 0) && (ec = {n, alsa_category}))
-        return m_current_specs;
-
-    m_mangled_revents = static_cast<bool>(m_pfds.data()->events & POLLIN);
-
-    if(m_asio_fd.is_open()) {
-        m_asio_fd.cancel();
-        m_asio_fd.close();
-    }
-    if(m_asio_fd.assign(m_pfds.data()->fd, ec))
-        return m_current_specs;
-
-    {
-        auto events = m_pfds.data()->events;
-        if(events & POLLERR)
-            TRACE_LOG(logject) << "events: POLLERR";
-        if(events & POLLOUT)
-            TRACE_LOG(logject) << "events: POLLOUT";
-        if(events & POLLIN)
-            TRACE_LOG(logject) << "events: POLLIN";
-        if(events & POLLPRI)
-            TRACE_LOG(logject) << "events: POLLPRI";
-        if(events & POLLRDHUP)
-            TRACE_LOG(logject) << "events: POLLRDHUP";
-        if(events & POLLHUP)
-            TRACE_LOG(logject) << "events: POLLHUP";
-        if(events & POLLNVAL)
-            TRACE_LOG(logject) << "events: POLLNVAL";
-        if(events & POLLRDNORM)
-            TRACE_LOG(logject) << "events: POLLRDNORM";
-        if(events & POLLRDBAND)
-            TRACE_LOG(logject) << "events: POLLRDBAND";
-        if(events & POLLWRNORM)
-            TRACE_LOG(logject) << "events: POLLWRNORM";
-        if(events & POLLWRBAND)
-            TRACE_LOG(logject) << "events: POLLWRBAND";
-    }
-    m_pfds.clear();
-
-    m_state = Melosic::Output::DeviceState::Ready;
-    assert(!ec);
-    TRACE_LOG(logject) << "internal state after prepare: " << snd_pcm_state_name(snd_pcm_state(m_pdh));
+        return;
 
-    return m_current_specs;
+    snd_pcm_hw_params_get_buffer_size(m_params, &buffer_frames);
+    snd_pcm_hw_params_get_period_size(m_params, &period_frames, &dir);
+    m_buffering.buffer_frames = buffer_frames;
+    m_buffering.period_frames = period_frames;
+    LOG(logject) << "Latency target " << chrono::duration_cast<chrono::milliseconds>(m_latency).count()
+                 << "ms; buffer " << buffer_frames << " frames ("
+                 << m_current_specs.samples_to_time<chrono::milliseconds>(buffer_frames).count() << "ms), period "
+                 << period_frames << " frames";
 }
 
 void output_service_impl::play(std::error_code& ec) {
@@ -290,18 +365,15 @@ void output_service_impl::unpause(std::error_code& ec) {
     assert(!ec);
 }
 
+// the handle stays open with its hw params installed, so playing again only needs snd_pcm_prepare
 void output_service_impl::stop(std::error_code& ec) {
     if(m_state != Melosic::Output::DeviceState::Stopped && m_state != Melosic::Output::DeviceState::Error && m_pdh) {
         cancel(ec);
         if((ec = {snd_pcm_drop(m_pdh), alsa_category}))
             return;
-        if((ec = {snd_pcm_close(m_pdh), alsa_category}))
-            return;
     }
     m_pfds.clear();
-    m_asio_fd.release();
     m_state = Melosic::Output::DeviceState::Stopped;
-    m_pdh = nullptr;
     assert(!ec);
 }
 
@@ -319,11 +391,16 @@ size_t output_service_impl::write_some(const asio::const_buffer& buf, std::error
         return 0;
 
     auto frames = snd_pcm_bytes_to_frames(m_pdh, size);
-    auto r = snd_pcm_writei(m_pdh, ptr, frames);
+    auto r = m_mmap ? mmap_write(ptr, frames) : snd_pcm_writei(m_pdh, ptr, frames);
 
     if(r < 0) {
-        if(m_pdh != nullptr)
+        if(r == -EPIPE)
+            m_xruns.fetch_add(1, std::memory_order_relaxed);
+        if(m_pdh != nullptr) {
             r = snd_pcm_recover(m_pdh, r, false);
+            if(r == 0)
+                m_recoveries.fetch_add(1, std::memory_order_relaxed);
+        }
         ec = {static_cast<int>(r), alsa_category};
         return 0;
     }
@@ -334,8 +411,51 @@ size_t output_service_impl::write_some(const asio::const_buffer& buf, std::error
     return r;
 }
 
-void output_service_impl::async_prepare(const Melosic::AudioSpecs,
-                                        Melosic::AudioIO::AudioOutputServiceBase::PrepareHandler) {
+snd_pcm_sframes_t output_service_impl::mmap_write(const char* ptr, snd_pcm_uframes_t frames) {
+    const auto avail = snd_pcm_avail_update(m_pdh);
+    if(avail < 0)
+        return avail;
+    frames = std::min(frames, static_cast<snd_pcm_uframes_t>(avail));
+
+    snd_pcm_uframes_t written = 0;
+    // the free space may wrap around the end of the device buffer
+    while(written < frames) {
+        const snd_pcm_channel_area_t* areas = nullptr;
+        snd_pcm_uframes_t offset = 0, n = frames - written;
+        const auto began = snd_pcm_mmap_begin(m_pdh, &areas, &offset, &n);
+        if(began < 0)
+            return began;
+        // interleaved channels share the first area; first and step are in bits
+        auto dst = static_cast<char*>(areas[0].addr) + (areas[0].first + offset * areas[0].step) / 8;
+        std::memcpy(dst, ptr + snd_pcm_frames_to_bytes(m_pdh, written), snd_pcm_frames_to_bytes(m_pdh, n));
+        const auto r = snd_pcm_mmap_commit(m_pdh, offset, n);
+        if(r < 0)
+            return r;
+        written += r;
+        if(static_cast<snd_pcm_uframes_t>(r) != n)
+            break;
+    }
+
+    // unlike snd_pcm_writei, committing doesn't start the stream
+    if(written > 0 && snd_pcm_state(m_pdh) == SND_PCM_STATE_PREPARED) {
+        const auto r = snd_pcm_start(m_pdh);
+        if(r < 0)
+            return r;
+    }
+    return written;
+}
+
+void output_service_impl::async_prepare(const Melosic::AudioSpecs as,
+                                        Melosic::AudioIO::AudioOutputServiceBase::PrepareHandler handler) {
+    // opening and negotiating can take 100ms or more, which would hold up every other output's writes on the
+    // audio thread. the caller mustn't use this output until the handler runs, on the audio thread as usual
+    if(m_prepare_thread.joinable())
+        m_prepare_thread.join();
+    m_prepare_thread = std::thread([this, as, handler = std::move(handler)]() mutable {
+        std::error_code ec;
+        const auto out_as = prepare(as, ec);
+        asio::post(get_io_service(), [handler = std::move(handler), ec, out_as] { handler(ec, out_as); });
+    });
 }
 
 void output_service_impl::async_write_some(const asio::const_buffer& buf,
@@ -352,6 +472,20 @@ void output_service_impl::async_write_some(const asio::const_buffer& buf,
                          std::move(f));
 }
 
+void output_service_impl::async_write_some(const Melosic::AudioIO::const_buffers& bufs,
+                                           Melosic::AudioIO::AudioOutputServiceBase::WriteHandler handler) {
+    auto f = [=](std::error_code ec) {
+        size_t n = 0;
+        if(!ec)
+            n = write_some(bufs, ec);
+        handler(ec, n);
+    };
+
+    m_asio_fd.async_wait(m_mangled_revents ? asio::posix::stream_descriptor::wait_read
+                                           : asio::posix::stream_descriptor::wait_write,
+                         std::move(f));
+}
+
 Melosic::AudioSpecs output_service_impl::current_specs() const {
     return m_current_specs;
 }
@@ -360,6 +494,34 @@ Melosic::Output::DeviceState output_service_impl::state() const {
     return m_state;
 }
 
+void output_service_impl::latency(chrono::microseconds target) {
+    m_latency = target;
+}
+
+Melosic::AudioIO::output_buffering output_service_impl::buffering() const {
+    return m_buffering;
+}
+
+size_t output_service_impl::delay(std::error_code& ec) {
+    if(m_pdh == nullptr || (m_state != Melosic::Output::DeviceState::Playing &&
+                            m_state != Melosic::Output::DeviceState::Paused)) {
+        ec.clear();
+        return 0;
+    }
+    snd_pcm_sframes_t frames = 0;
+    if((ec = {snd_pcm_delay(m_pdh, &frames), alsa_category}))
+        return 0;
+    // negative after an underrun
+    return std::max<snd_pcm_sframes_t>(frames, 0);
+}
+
+Melosic::AudioIO::output_stats output_service_impl::stats() const {
+    Melosic::AudioIO::output_stats s;
+    s.xruns = m_xruns.load(std::memory_order_relaxed);
+    s.recoveries = m_recoveries.load(std::memory_order_relaxed);
+    return s;
+}
+
 bool output_service_impl::non_blocking() const {
     return m_non_blocking;
 }
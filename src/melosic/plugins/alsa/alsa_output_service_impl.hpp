@@ -18,10 +18,16 @@
 #ifndef ALSA_OUTPUT_SERVICE_IMPL_HPP
 #define ALSA_OUTPUT_SERVICE_IMPL_HPP
 
+#include <atomic>
+#include <thread>
+#include <tuple>
+
+#include <asio/post.hpp>
 #include <asio/posix/stream_descriptor.hpp>
 
 #include <alsa/asoundlib.h>
 
+#include <melosic/common/optional.hpp>
 #include <melosic/melin/exports.hpp>
 #include <melosic/melin/output.hpp>
 #include <melosic/asio/audio_impl.hpp>
@@ -33,6 +39,9 @@ namespace alsa {
 struct MELOSIC_EXPORT output_service_impl : Melosic::AudioIO::AudioOutputServiceBase {
     using base_t = Melosic::AudioIO::AudioOutputServiceBase;
 
+    /// device, channels, bps, sample rate, latency target (us), mmap allowed, resampling allowed
+    using hw_key = std::tuple<std::string, uint8_t, uint8_t, uint32_t, int64_t, bool, bool>;
+
     explicit output_service_impl(asio::io_service& service);
 
     void assign(Melosic::Output::device_descriptor dev_name, std::error_code& ec) override;
@@ -51,31 +60,51 @@ struct MELOSIC_EXPORT output_service_impl : Melosic::AudioIO::AudioOutputService
 
     void stop(std::error_code& ec) override;
 
+    using base_t::write_some;
     size_t write_some(const asio::const_buffer& buf, std::error_code& ec) override;
 
     void async_prepare(const Melosic::AudioSpecs, PrepareHandler) override;
 
     void async_write_some(const asio::const_buffer& buf, WriteHandler handler) override;
+    void async_write_some(const Melosic::AudioIO::const_buffers& bufs, WriteHandler handler) override;
 
     Melosic::AudioSpecs current_specs() const override;
 
     Melosic::Output::DeviceState state() const override;
 
+    void latency(chrono::microseconds target) override;
+
+    Melosic::AudioIO::output_buffering buffering() const override;
+
+    size_t delay(std::error_code& ec) override;
+
+    Melosic::AudioIO::output_stats stats() const override;
+
     bool non_blocking() const override;
 
     void non_blocking(bool mode, std::error_code& ec) override;
 
   private:
+    void negotiate(Melosic::AudioSpecs as, std::error_code& ec);
+    snd_pcm_sframes_t mmap_write(const char* ptr, snd_pcm_uframes_t frames);
+
     snd_pcm_t* m_pdh = nullptr;
     snd_pcm_hw_params_t* m_params = nullptr;
+    Melosic::optional<hw_key> m_installed; // what m_pdh's hw params were negotiated for
     std::vector<pollfd> m_pfds;
     asio::posix::stream_descriptor m_asio_fd;
     bool m_non_blocking = true;
+    bool m_mmap = false;
+    chrono::microseconds m_latency{chrono::milliseconds(200)};
+    Melosic::AudioIO::output_buffering m_buffering;
     bool m_mangled_revents = true;
     Melosic::AudioSpecs m_current_specs;
     std::string m_name{"default"};
     std::string m_desc;
     Melosic::Output::DeviceState m_state;
+    std::atomic<uint64_t> m_xruns{0};
+    std::atomic<uint64_t> m_recoveries{0};
+    std::thread m_prepare_thread; // of async_prepare()
 };
 
 } // namespace alsa
@@ -15,6 +15,8 @@
 **  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 
+#include <algorithm>
+
 #include <openssl/md5.h>
 
 #include "flacdecoder.hpp"
@@ -31,7 +33,13 @@ std::unique_ptr<Melosic::Decoder::PCMSource> provider::make_decoder(std::unique_
 }
 
 bool provider::verify(std::unique_ptr<std::istream> in) const {
-    return false;
+    auto decoder = std::make_unique<FlacDecoder>(std::move(in));
+    const auto expected_md5 = decoder->md5();
+    // encoders may leave it unset
+    if(std::all_of(expected_md5.begin(), expected_md5.end(), [](auto c) { return c == 0; }))
+        return false;
+
+    return get_pcm_md5(std::move(decoder)) == expected_md5;
 }
 
 } // namespace flac
@@ -15,17 +15,29 @@
 **  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 
+#include <vector>
+#include <functional>
+#include <deque>
+#include <future>
+#include <cstring>
+
 #include <boost/iostreams/read.hpp>
 #include <boost/iostreams/positioning.hpp>
 #include <boost/iostreams/seek.hpp>
 namespace io = boost::iostreams;
 
 #include <asio/error.hpp>
+#include <asio/post.hpp>
+#include <asio/thread_pool.hpp>
 
 #include <melosic/common/error.hpp>
 #include <melosic/melin/logging.hpp>
 #include <melosic/common/audiospecs.hpp>
 #include <melosic/common/pcmbuffer.hpp>
+#include <melosic/common/pcm_sample.hpp>
+#include <melosic/common/sample_convert.hpp>
+#include <melosic/common/seek_index.hpp>
+#include <melosic/common/optional.hpp>
 
 #include <FLAC++/decoder.h>
 
@@ -35,19 +47,182 @@ namespace flac {
 
 static Logger::Logger logject{logging::keywords::channel = "FLAC"};
 
+// libFLAC hands out right-justified samples, one array per channel; packed by width with pcm_sample.hpp
+using pack_planar_fn = void (*)(const FLAC__int32* const[], unsigned, std::size_t, std::size_t, void*);
+using pack_interleaved_fn = void (*)(const FLAC__int32*, std::size_t, void*);
+
 #define FLAC_THROW_IF(Exc, cond, flacptr)                                                                              \
     if(!(cond)) {                                                                                                      \
         BOOST_THROW_EXCEPTION(Exc() << ErrorTag::Plugin::Info(flacInfo)                                              \
                                     << ErrorTag::DecodeErrStr(flacptr->get_state().as_cstring()));                     \
     }
 
+// CRC-8 of a frame header; polynomial x^8 + x^2 + x + 1
+static uint8_t header_crc8(const uint8_t* p, size_t n) noexcept {
+    uint8_t crc = 0;
+    while(n--) {
+        crc ^= *p++;
+        for(int i = 0; i < 8; ++i)
+            crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+    return crc;
+}
+
+// The first sample of the frame whose header starts at p, if there is a valid one belonging to the stream described
+// by info. The CRC makes a sync code turning up inside frame data unlikely to pass.
+static optional<uint64_t> frame_header_sample(const uint8_t* p, size_t len,
+                                              const FLAC__StreamMetadata_StreamInfo& info) noexcept {
+    if(len < 6 || p[0] != 0xff || (p[1] & 0xfe) != 0xf8)
+        return nullopt;
+    const bool variable_blocksize = p[1] & 1;
+    const unsigned blocksize_code = p[2] >> 4, rate_code = p[2] & 0xf;
+    const unsigned channel_code = p[3] >> 4, bps_code = (p[3] >> 1) & 0x7;
+    if(blocksize_code == 0 || rate_code == 0xf || channel_code > 10 || bps_code == 3 || (p[3] & 1))
+        return nullopt;
+    static constexpr unsigned bps_codes[] = {0, 8, 12, 0, 16, 20, 24, 32};
+    if((channel_code < 8 ? channel_code + 1 : 2) != info.channels ||
+       (bps_code != 0 && bps_codes[bps_code] != info.bits_per_sample))
+        return nullopt;
+
+    // frame or sample number, UTF-8 coded
+    size_t i = 4;
+    uint64_t number = p[i++];
+    if(number & 0x80) {
+        if((number & 0xc0) == 0x80 || number == 0xff)
+            return nullopt;
+        unsigned extra = 0;
+        while(number & (0x40 >> extra))
+            ++extra;
+        number &= 0x3f >> extra;
+        if(len < i + extra + 1)
+            return nullopt;
+        for(unsigned k = 0; k < extra; ++k, ++i) {
+            if((p[i] & 0xc0) != 0x80)
+                return nullopt;
+            number = (number << 6) | (p[i] & 0x3f);
+        }
+    }
+    i += blocksize_code == 6 ? 1 : blocksize_code == 7 ? 2 : 0;
+    i += rate_code == 12 ? 1 : (rate_code == 13 || rate_code == 14) ? 2 : 0;
+    if(len <= i || header_crc8(p, i) != p[i])
+        return nullopt;
+
+    const uint64_t sample = variable_blocksize ? number : number * info.min_blocksize;
+    if(info.total_samples != 0 && sample >= info.total_samples)
+        return nullopt;
+    return sample;
+}
+
+using stream_header = std::array<char, 42>;
+
+// "fLaC" and a lone STREAMINFO block; enough for libFLAC to decode frames cut from the stream it describes
+static stream_header make_stream_header(const FLAC__StreamMetadata_StreamInfo& info) noexcept {
+    stream_header header{{'f', 'L', 'a', 'C', static_cast<char>(0x80), 0, 0, 34}};
+    auto p = reinterpret_cast<uint8_t*>(header.data() + 8);
+    size_t bit = 0;
+    auto put = [&](uint64_t v, unsigned bits) {
+        while(bits--) {
+            if((v >> bits) & 1)
+                p[bit / 8] |= 0x80 >> (bit % 8);
+            ++bit;
+        }
+    };
+    put(info.min_blocksize, 16);
+    put(info.max_blocksize, 16);
+    put(info.min_framesize, 24);
+    put(info.max_framesize, 24);
+    put(info.sample_rate, 20);
+    put(info.channels - 1, 3);
+    put(info.bits_per_sample - 1, 5);
+    put(info.total_samples, 36);
+    std::memcpy(p + bit / 8, info.md5sum, sizeof(info.md5sum));
+    return header;
+}
+
+// Decodes a run of whole frames, cut from a stream and put behind a stand-in header, to packed PCM.
+// Used from worker threads, so errors are held until the run is done rather than thrown from libFLAC's callbacks.
+struct chunk_decoder : FLAC::Decoder::Stream {
+    chunk_decoder(const stream_header& header, const char* data, size_t size, pack_planar_fn pack, AudioSpecs as)
+        : header(header), data(data), size(size), pack(pack), as(as) {
+    }
+
+    ~chunk_decoder() {
+        finish();
+    }
+
+    // frames is the number of frames the run should hold, or 0 if unknown
+    std::vector<char> decode(uint64_t frames) {
+        out.reserve(as.samples_to_bytes(frames));
+        FLAC_THROW_IF(DecoderInitException, init() == FLAC__STREAM_DECODER_INIT_STATUS_OK, this);
+        const auto ok = process_until_end_of_stream();
+        if(error) {
+            BOOST_THROW_EXCEPTION(AudioDataInvalidException()
+                                  << ErrorTag::Plugin::Info(flacInfo)
+                                  << ErrorTag::DecodeErrStr(FLAC__StreamDecoderErrorStatusString[*error]));
+        }
+        FLAC_THROW_IF(AudioDataInvalidException, ok, this);
+        if(frames != 0 && out.size() != as.samples_to_bytes(frames)) {
+            BOOST_THROW_EXCEPTION(AudioDataInvalidException() << ErrorTag::Plugin::Info(flacInfo)
+                                                              << ErrorTag::DecodeErrStr("Frames missing from chunk"));
+        }
+        return std::move(out);
+    }
+
+    ::FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t* bytes) override {
+        size_t n = 0;
+        if(pos < header.size()) {
+            n = std::min(*bytes, header.size() - pos);
+            std::memcpy(buffer, header.data() + pos, n);
+        } else if(pos < header.size() + size) {
+            n = std::min(*bytes, header.size() + size - pos);
+            std::memcpy(buffer, data + (pos - header.size()), n);
+        }
+        pos += n;
+        *bytes = n;
+        return n > 0 ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+    }
+
+    ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame* frame,
+                                                    const FLAC__int32* const buffer[]) override {
+        const auto offset = out.size();
+        out.resize(offset + as.samples_to_bytes(frame->header.blocksize));
+        pack(buffer, frame->header.channels, 0, frame->header.blocksize, out.data() + offset);
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    void error_callback(::FLAC__StreamDecoderErrorStatus status) override {
+        if(!error)
+            error = status;
+    }
+
+    const stream_header& header;
+    const char* data;
+    size_t size;
+    size_t pos{0};
+    pack_planar_fn pack;
+    AudioSpecs as;
+    std::vector<char> out;
+    optional<::FLAC__StreamDecoderErrorStatus> error;
+};
+
 struct FlacDecoder::FlacDecoderImpl : FLAC::Decoder::Stream {
-    FlacDecoderImpl(std::unique_ptr<std::istream> input, AudioSpecs&, std::deque<char>&);
+    FlacDecoderImpl(std::unique_ptr<std::istream> input, AudioSpecs&);
 
     virtual ~FlacDecoderImpl();
 
     bool end() const;
 
+    size_t buffered() const {
+        return buf.size() - buf_pos;
+    }
+    // decodes until at least samples are buffered or the stream ends; returns samples available, up to samples
+    size_t fill(size_t samples, std::error_code& ec);
+    // decodes straight into out until frames are written or the stream ends, buffering the rest of the last frame;
+    // returns frames written
+    size_t decode_into(char* out, size_t frames);
+    // frame starts about every chunk_bytes through file, the whole stream, beginning with the first frame
+    std::vector<seek_point> split(const std::vector<char>& file, size_t chunk_bytes) const;
+
     ::FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t* bytes) override;
     ::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame* frame,
                                                     const FLAC__int32* const buffer[]) override;
@@ -61,23 +236,52 @@ struct FlacDecoder::FlacDecoderImpl : FLAC::Decoder::Stream {
 
     std::unique_ptr<std::istream> m_input;
     AudioSpecs& as;
-    std::deque<char>& buf;
+    // decoded interleaved samples, right-justified as libFLAC gives them; read from buf_pos.
+    // when decoding into out, only what doesn't fit; reserved to a whole frame
+    std::vector<FLAC__int32> buf;
+    size_t buf_pos{0};
+    // the caller's buffer while in decode_into()
+    char* out{nullptr};
+    size_t out_frames{0};
+    size_t out_written{0};
+    // chosen for the stream's width
+    pack_planar_fn pack_planar{nullptr};
+    pack_interleaved_fn pack_interleaved{nullptr};
+
+    // frame offsets are recorded while decoding sequentially, one per second of audio
+    seek_index index;
+    bool index_grew{false};
+    std::function<void(const seek_index&)> indexed;
+    // offset of the next frame; unknown after a seek until a frame has been decoded
+    optional<uint64_t> frame_offset;
+    // frames still to drop after seeking to an indexed point before the target
+    uint64_t skip{0};
+    // where the first frame begins, and the stream's seek table, offsets from the first frame
+    uint64_t first_frame_offset{0};
+    std::vector<seek_point> seek_table;
     std::streampos start;
     FLAC__StreamMetadata_StreamInfo m_metadata_cache;
     uint64_t lastSample{0};
 };
 
-FlacDecoder::FlacDecoderImpl::FlacDecoderImpl(std::unique_ptr<std::istream> input, AudioSpecs& as,
-                                              std::deque<char>& buf)
-    : m_input(std::move(input)), as(as), buf(buf) {
+FlacDecoder::FlacDecoderImpl::FlacDecoderImpl(std::unique_ptr<std::istream> input, AudioSpecs& as)
+    : m_input(std::move(input)), as(as) {
     assert(m_input != nullptr);
     m_input->exceptions(std::istream::badbit | std::istream::failbit);
+    set_metadata_respond(FLAC__METADATA_TYPE_SEEKTABLE);
     FLAC_THROW_IF(DecoderInitException, init() == FLAC__STREAM_DECODER_INIT_STATUS_OK, this);
     FLAC_THROW_IF(MetadataException, process_until_end_of_metadata(), this);
     start = io::seek(*m_input, 0, std::ios_base::cur);
+    index = seek_index{as.sample_rate};
+    FLAC__uint64 first_frame;
+    if(get_decode_position(&first_frame)) {
+        index.add({0, first_frame});
+        first_frame_offset = first_frame;
+    }
     FLAC_THROW_IF(AudioDataInvalidException, process_single() && seek_absolute(0), this);
     reset();
     buf.clear();
+    buf_pos = 0;
 }
 
 FlacDecoder::FlacDecoderImpl::~FlacDecoderImpl() {
@@ -89,6 +293,93 @@ bool FlacDecoder::FlacDecoderImpl::end() const {
     return state == FLAC__STREAM_DECODER_END_OF_STREAM || state == FLAC__STREAM_DECODER_ABORTED;
 }
 
+size_t FlacDecoder::FlacDecoderImpl::fill(size_t samples, std::error_code& ec) {
+    while(buffered() < samples && !end()) {
+        auto r = process_single();
+        if(!r || FLAC__STREAM_DECODER_END_OF_STREAM == static_cast<FLAC__StreamDecoderState>(get_state())) {
+            if(index_grew && indexed) {
+                TRACE_LOG(logject) << "Indexed " << index.size() << " seek points";
+                index_grew = false;
+                indexed(index);
+            }
+            if(buffered() == 0) {
+                ec = asio::error::make_error_code(asio::error::eof);
+                return 0;
+            } else
+                break;
+        }
+
+        FLAC_THROW_IF(AudioDataInvalidException, r, this);
+    }
+    return std::min(samples, buffered());
+}
+
+size_t FlacDecoder::FlacDecoderImpl::decode_into(char* const dst, const size_t frames) {
+    // not left pointing at the caller's buffer should decoding throw
+    struct out_guard {
+        ~out_guard() {
+            d.out = nullptr;
+            d.out_frames = 0;
+        }
+        FlacDecoderImpl& d;
+    } guard{*this};
+    out = dst;
+    out_frames = frames;
+    out_written = 0;
+    while(out_frames > 0 && !end()) {
+        auto r = process_single();
+        if(!r || FLAC__STREAM_DECODER_END_OF_STREAM == static_cast<FLAC__StreamDecoderState>(get_state())) {
+            if(index_grew && indexed) {
+                TRACE_LOG(logject) << "Indexed " << index.size() << " seek points";
+                index_grew = false;
+                indexed(index);
+            }
+            break;
+        }
+    }
+    return out_written;
+}
+
+std::vector<seek_point> FlacDecoder::FlacDecoderImpl::split(const std::vector<char>& file,
+                                                             const size_t chunk_bytes) const {
+    const auto bytes = reinterpret_cast<const uint8_t*>(file.data());
+    // frame starts already known; checked before use, as the index may be stale
+    std::vector<seek_point> known = index.points();
+    for(auto&& point : seek_table)
+        known.push_back({point.sample, first_frame_offset + point.offset});
+    std::sort(known.begin(), known.end(), [](auto&& a, auto&& b) { return a.offset < b.offset; });
+
+    std::vector<seek_point> bounds{{0, first_frame_offset}};
+    while(bounds.back().offset + chunk_bytes < file.size()) {
+        const auto target = bounds.back().offset + chunk_bytes;
+        const auto window_end = std::min<uint64_t>(target + chunk_bytes, file.size());
+        optional<seek_point> next;
+
+        // a known start within the next chunk saves scanning for one
+        auto it = std::lower_bound(known.begin(), known.end(), target,
+                                   [](auto&& point, uint64_t offset) { return point.offset < offset; });
+        for(; it != known.end() && it->offset < window_end && !next; ++it) {
+            if(it->sample > bounds.back().sample &&
+               frame_header_sample(bytes + it->offset, file.size() - it->offset, m_metadata_cache) == it->sample)
+                next = *it;
+        }
+
+        for(auto p = bytes + target, end = bytes + file.size(); !next && p < end; ++p) {
+            p = static_cast<const uint8_t*>(std::memchr(p, 0xff, end - p));
+            if(p == nullptr)
+                break;
+            const auto sample = frame_header_sample(p, end - p, m_metadata_cache);
+            if(sample && *sample > bounds.back().sample)
+                next = seek_point{*sample, static_cast<uint64_t>(p - bytes)};
+        }
+
+        if(!next)
+            break;
+        bounds.push_back(*next);
+    }
+    return bounds;
+}
+
 FLAC__StreamDecoderReadStatus FlacDecoder::FlacDecoderImpl::read_callback(FLAC__byte buffer[], size_t* bytes) {
     try {
         auto n = io::read(*m_input, reinterpret_cast<char*>(buffer), *bytes);
@@ -110,38 +401,22 @@ FLAC__StreamDecoderReadStatus FlacDecoder::FlacDecoderImpl::read_callback(FLAC__
 
 FLAC__StreamDecoderWriteStatus FlacDecoder::FlacDecoderImpl::write_callback(const FLAC__Frame* frame,
                                                                             const FLAC__int32* const buffer[]) {
+    const uint64_t first_sample = frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_FRAME_NUMBER
+                                      ? uint64_t(frame->header.number.frame_number) * frame->header.blocksize
+                                      : frame->header.number.sample_number;
+    if(frame_offset && index.add({first_sample, *frame_offset}))
+        index_grew = true;
+    FLAC__uint64 next_offset;
+    frame_offset = get_decode_position(&next_offset) ? optional<uint64_t>{next_offset} : nullopt;
+
     lastSample = frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_FRAME_NUMBER ? frame->header.number.frame_number
                                                                                    : frame->header.number.sample_number;
     lastSample += frame->header.blocksize * as.channels;
     switch(frame->header.bits_per_sample) {
         case 8:
-            for(unsigned i = 0, u = 0; i < frame->header.blocksize && u < (frame->header.blocksize * as.channels); i++)
-                for(unsigned j = 0; j < frame->header.channels; j++, u++)
-                    buf.push_back(static_cast<char>(buffer[j][i]));
-            break;
         case 16:
-            for(unsigned i = 0, u = 0; i < frame->header.blocksize && u < (frame->header.blocksize * as.channels); i++)
-                for(unsigned j = 0; j < frame->header.channels; j++, u++) {
-                    buf.push_back(static_cast<char>(buffer[j][i]));
-                    buf.push_back(static_cast<char>(buffer[j][i] >> 8));
-                }
-            break;
         case 24:
-            for(unsigned i = 0, u = 0; i < frame->header.blocksize && u < (frame->header.blocksize * as.channels); i++)
-                for(unsigned j = 0; j < frame->header.channels; j++, u++) {
-                    buf.push_back(static_cast<char>(buffer[j][i]));
-                    buf.push_back(static_cast<char>(buffer[j][i] >> 8));
-                    buf.push_back(static_cast<char>(buffer[j][i] >> 16));
-                }
-            break;
         case 32:
-            for(unsigned i = 0, u = 0; i < frame->header.blocksize && u < (frame->header.blocksize * as.channels); i++)
-                for(unsigned j = 0; j < frame->header.channels; j++, u++) {
-                    buf.push_back(static_cast<char>(buffer[j][i]));
-                    buf.push_back(static_cast<char>(buffer[j][i] >> 8));
-                    buf.push_back(static_cast<char>(buffer[j][i] >> 16));
-                    buf.push_back(static_cast<char>(buffer[j][i] >> 24));
-                }
             break;
         default:
             BOOST_THROW_EXCEPTION(AudioDataUnsupported() << ErrorTag::Plugin::Info(flacInfo)
@@ -149,6 +424,30 @@ FLAC__StreamDecoderWriteStatus FlacDecoder::FlacDecoderImpl::write_callback(cons
             break;
     }
 
+    // drop what has been read so the buffer stays around a frame in size
+    if(buf_pos > 0) {
+        buf.erase(buf.begin(), std::next(buf.begin(), buf_pos));
+        buf_pos = 0;
+    }
+    const auto channels = frame->header.channels;
+    auto first = static_cast<unsigned>(std::min<uint64_t>(skip, frame->header.blocksize));
+    skip -= first;
+    if(out != nullptr) {
+        const auto n = static_cast<unsigned>(std::min<size_t>(frame->header.blocksize - first, out_frames));
+        pack_planar(buffer, channels, first, n, out);
+        out += as.samples_to_bytes(n);
+        out_frames -= n;
+        out_written += n;
+        first += n;
+    }
+    // whatever didn't fit, or all of it for decode_float()
+    const auto offset = buf.size();
+    buf.resize(offset + (frame->header.blocksize - first) * channels);
+    auto tail = buf.data() + offset;
+    for(unsigned j = 0; j < channels; j++)
+        for(unsigned i = first; i < frame->header.blocksize; i++)
+            tail[(i - first) * channels + j] = buffer[j][i];
+
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
@@ -164,8 +463,38 @@ void FlacDecoder::FlacDecoderImpl::metadata_callback(const FLAC__StreamMetadata*
 
         as = {static_cast<uint8_t>(m_metadata_cache.channels), static_cast<uint8_t>(m_metadata_cache.bits_per_sample),
               m_metadata_cache.sample_rate};
+        buf.reserve(m_metadata_cache.max_blocksize * m_metadata_cache.channels);
+        switch(as.bps_in_bytes()) {
+            case 1:
+                pack_planar = &Melosic::pack_planar<8>;
+                pack_interleaved = &Melosic::pack<8>;
+                break;
+            case 2:
+                pack_planar = &Melosic::pack_planar<16>;
+                pack_interleaved = &Melosic::pack<16>;
+                break;
+            case 3:
+                pack_planar = &Melosic::pack_planar<24>;
+                pack_interleaved = &Melosic::pack<24>;
+                break;
+            case 4:
+                pack_planar = &Melosic::pack_planar<32>;
+                pack_interleaved = &Melosic::pack<32>;
+                break;
+            default:
+                BOOST_THROW_EXCEPTION(AudioDataUnsupported() << ErrorTag::Plugin::Info(flacInfo)
+                                                             << ErrorTag::BPS(as.bps));
+        }
 
         TRACE_LOG(logject) << as;
+    } else if(metadata->type == FLAC__METADATA_TYPE_SEEKTABLE) {
+        // seen again whenever libFLAC is reset
+        const auto& table = metadata->data.seek_table;
+        seek_table.clear();
+        for(unsigned i = 0; i < table.num_points; ++i) {
+            if(table.points[i].sample_number != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER)
+                seek_table.push_back({table.points[i].sample_number, table.points[i].stream_offset});
+        }
     }
 }
 
@@ -194,7 +523,7 @@ bool FlacDecoder::FlacDecoderImpl::eof_callback() {
 }
 
 FlacDecoder::FlacDecoder(std::unique_ptr<std::istream> input)
-    : as(), buf(), m_decoder(std::make_unique<FlacDecoderImpl>(std::move(input), as, buf)) {
+    : as(), m_decoder(std::make_unique<FlacDecoderImpl>(std::move(input), as)) {
 }
 
 FlacDecoder::~FlacDecoder() {
@@ -202,29 +531,175 @@ FlacDecoder::~FlacDecoder() {
 
 size_t FlacDecoder::decode(PCMBuffer& pcm_buf, std::error_code& ec) {
     pcm_buf.audio_specs = as;
-    while(buf.size() < asio::buffer_size(pcm_buf) && !m_decoder->end()) {
-        auto r = m_decoder->process_single();
-        if(!r || FLAC__STREAM_DECODER_END_OF_STREAM == static_cast<FLAC__StreamDecoderState>(m_decoder->get_state())) {
-            if(buf.empty()) {
-                ec = asio::error::make_error_code(asio::error::eof);
-                return 0;
-            } else
-                break;
-        }
+    auto out = asio::buffer_cast<char*>(pcm_buf);
+    const auto frames = as.bytes_to_samples(asio::buffer_size(pcm_buf));
+
+    // little-endian, packed; first the tail of the last frame, then straight from libFLAC
+    const auto held = std::min(frames, m_decoder->buffered() / as.channels);
+    m_decoder->pack_interleaved(m_decoder->buf.data() + m_decoder->buf_pos, held * as.channels, out);
+    m_decoder->buf_pos += held * as.channels;
+    const auto n = held + m_decoder->decode_into(out + as.samples_to_bytes(held), frames - held);
+
+    if(n == 0 && !valid()) {
+        ec = asio::error::make_error_code(asio::error::eof);
+        return 0;
+    }
+    return as.samples_to_bytes(n);
+}
+
+size_t FlacDecoder::decode_float(float* out, size_t frames, std::error_code& ec) {
+    const auto n = m_decoder->fill(frames * as.channels, ec);
+    if(ec)
+        return 0;
+
+    // straight from libFLAC's integers; no packing and unpacking
+    int_to_float(m_decoder->buf.data() + m_decoder->buf_pos, n, as.bps, out);
+    m_decoder->buf_pos += n;
+    return n / as.channels;
+}
+
+void FlacDecoder::decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads,
+                             std::error_code& ec) {
+    // big enough to amortise each chunk's start up, small enough to spread a track across cores
+    decode_all(sink, threads, 256 * 1024, ec);
+}
+
+void FlacDecoder::decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads,
+                             size_t chunk_bytes, std::error_code& ec) {
+    auto& d = *m_decoder;
+    // chunks are cut from the first frame on, so it has to have been found
+    if(threads < 2 || d.first_frame_offset == 0)
+        return PCMSource::decode_all(sink, threads, ec);
 
-        FLAC_THROW_IF(AudioDataInvalidException, r, m_decoder);
+    // frames are cut straight out of the stream in memory
+    std::vector<char> file;
+    try {
+        FLAC__uint64 length;
+        d.m_input->clear();
+        if(d.length_callback(&length) != FLAC__STREAM_DECODER_LENGTH_STATUS_OK)
+            return PCMSource::decode_all(sink, threads, ec);
+        file.resize(length);
+        io::seek(*d.m_input, 0, std::ios_base::beg);
+        if(io::read(*d.m_input, file.data(), file.size()) != static_cast<std::streamsize>(file.size()))
+            return PCMSource::decode_all(sink, threads, ec);
+    } catch(std::ios_base::failure& e) {
+        WARN_LOG(logject) << "Decoding sequentially; couldn't read stream: " << e.what();
+        d.m_input->clear();
+        return PCMSource::decode_all(sink, threads, ec);
+    }
+    // leave libFLAC somewhere sensible whichever way this returns
+    struct reset_guard {
+        ~reset_guard() {
+            decoder.reset();
+        }
+        FlacDecoder& decoder;
+    } guard{*this};
+
+    const auto bounds = d.split(file, chunk_bytes);
+    TRACE_LOG(logject) << "Decoding " << bounds.size() << " chunks on " << threads << " threads";
+
+    const auto header = make_stream_header(d.m_metadata_cache);
+    const auto total = d.m_metadata_cache.total_samples;
+    const auto pack = d.pack_planar;
+    const auto as = this->as;
+
+    // declared after what the workers read, so they are joined first
+    asio::thread_pool pool{threads};
+    std::deque<std::future<std::vector<char>>> pending;
+    size_t next = 0;
+    auto submit = [&] {
+        const auto begin = bounds[next];
+        const auto last = next + 1 == bounds.size();
+        const auto end = last ? file.size() : bounds[next + 1].offset;
+        // the last chunk's length is only known from STREAMINFO, if at all
+        const auto frames =
+            last ? (total > begin.sample ? total - begin.sample : 0) : bounds[next + 1].sample - begin.sample;
+        auto task = std::make_shared<std::packaged_task<std::vector<char>()>>([&, begin, end, frames] {
+            chunk_decoder chunk{header, file.data() + begin.offset, end - begin.offset, pack, as};
+            return chunk.decode(frames);
+        });
+        pending.push_back(task->get_future());
+        asio::post(pool, [task] { (*task)(); });
+        ++next;
+    };
+
+    // enough in flight to keep every thread busy while the oldest is handed out
+    while(next < bounds.size() && pending.size() < threads * 2)
+        submit();
+    // a false sync found by split() cuts a chunk mid-frame, so it fails to decode
+    optional<uint64_t> failed_at;
+    uint64_t emitted = 0;
+    for(size_t taken = 0; !pending.empty(); ++taken) {
+        std::vector<char> pcm;
+        try {
+            pcm = pending.front().get();
+        } catch(Exception&) {
+            failed_at = emitted;
+            break;
+        }
+        pending.pop_front();
+        // only a chunk which decoded shows its start to be a real frame
+        d.index_grew |= d.index.add(bounds[taken]);
+        if(next < bounds.size())
+            submit();
+        sink(pcm.data(), pcm.size());
+        emitted += as.bytes_to_samples(pcm.size());
+    }
+    pool.stop();
+    pool.join();
+
+    if(failed_at) {
+        WARN_LOG(logject) << "Chunk failed to decode; decoding sequentially from sample " << *failed_at;
+        d.m_input->clear();
+        d.buf.clear();
+        d.buf_pos = 0;
+        d.frame_offset = nullopt;
+        d.skip = 0;
+        FLAC_THROW_IF(AudioDataInvalidException, d.seek_absolute(*failed_at), &d);
+        std::vector<char> data(64 * 1024);
+        while(!ec) {
+            PCMBuffer buf{data.data(), data.size()};
+            const auto n = decode(buf, ec);
+            sink(data.data(), n);
+        }
+        if(ec == asio::error::eof)
+            ec.clear();
     }
 
-    auto min = std::min(asio::buffer_size(pcm_buf), buf.size());
-    auto m = std::move(buf.begin(), std::next(buf.begin(), min), asio::buffer_cast<char*>(pcm_buf));
-    auto d = std::distance(asio::buffer_cast<char*>(pcm_buf), m);
-    buf.erase(buf.begin(), std::next(buf.begin(), d));
+    if(d.index_grew && d.indexed) {
+        TRACE_LOG(logject) << "Indexed " << d.index.size() << " seek points";
+        d.index_grew = false;
+        d.indexed(d.index);
+    }
+}
 
-    return d == 0 && !valid() ? (-1) : d;
+std::array<unsigned char, 16> FlacDecoder::md5() const {
+    std::array<unsigned char, 16> sum;
+    std::memcpy(sum.data(), m_decoder->m_metadata_cache.md5sum, sum.size());
+    return sum;
 }
 
 void FlacDecoder::seek(chrono::milliseconds dur) {
-    if(!m_decoder->seek_absolute(as.time_to_samples(dur))) {
+    const auto target = as.time_to_samples(dur);
+    m_decoder->buf.clear();
+    m_decoder->buf_pos = 0;
+
+    if(auto point = m_decoder->index.find(target)) {
+        // one read at a known frame, decoding forward from there
+        TRACE_LOG(logject) << "Seeking to indexed frame at byte " << point->offset;
+        m_decoder->flush();
+        m_decoder->m_input->clear();
+        if(m_decoder->seek_callback(point->offset) == FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
+            m_decoder->frame_offset = point->offset;
+            m_decoder->skip = target - point->sample;
+            m_decoder->lastSample = point->sample;
+            return;
+        }
+    }
+
+    m_decoder->frame_offset = nullopt;
+    m_decoder->skip = 0;
+    if(!m_decoder->seek_absolute(target)) {
         WARN_LOG(logject) << "Seek to " << dur.count() << "ms failed";
         TRACE_LOG(logject) << "Position is " << tell().count() << "ms";
     }
@@ -241,7 +716,12 @@ chrono::milliseconds FlacDecoder::duration() const {
 void FlacDecoder::reset() {
     m_decoder->reset();
     seek(0ms);
-    buf.clear();
+}
+
+void FlacDecoder::set_seek_index(seek_index index, std::function<void(const seek_index&)> indexed) {
+    if(index.spacing() > 0 && !index.empty())
+        m_decoder->index = std::move(index);
+    m_decoder->indexed = std::move(indexed);
 }
 
 AudioSpecs FlacDecoder::getAudioSpecs() const {
@@ -249,7 +729,7 @@ AudioSpecs FlacDecoder::getAudioSpecs() const {
 }
 
 bool FlacDecoder::valid() const {
-    return !(m_decoder->end() && buf.empty());
+    return !(m_decoder->end() && m_decoder->buffered() == 0);
 }
 
 } // namespace flac
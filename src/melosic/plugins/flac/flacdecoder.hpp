@@ -20,7 +20,7 @@
 
 #include <memory>
 #include <istream>
-#include <deque>
+#include <array>
 #include <algorithm>
 #include <cmath>
 
@@ -44,16 +44,29 @@ class FLAC_MELIN_API FlacDecoder : public Decoder::PCMSource {
     virtual ~FlacDecoder();
 
     size_t decode(PCMBuffer& pcm_buf, std::error_code& ec) override;
+    size_t decode_float(float* out, size_t frames, std::error_code& ec) override;
     void seek(chrono::milliseconds dur) override;
     chrono::milliseconds tell() const override;
     chrono::milliseconds duration() const override;
     void reset() override;
     AudioSpecs getAudioSpecs() const override;
     bool valid() const override;
+    void set_seek_index(seek_index, std::function<void(const seek_index&)> indexed) override;
+
+    /// Decodes the whole stream in chunks of independently decodable frames, several at once.
+    /// Chunk boundaries come from the seek index and seek table where they can, otherwise from scanning for frame
+    /// headers. Reads the stream into memory; falls back to decoding sequentially if it cannot.
+    void decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads,
+                    std::error_code& ec) override;
+    /// decode_all(), splitting the stream about every chunk_bytes of encoded frames.
+    void decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads, size_t chunk_bytes,
+                    std::error_code& ec);
+
+    /// Checksum of the unencoded PCM from STREAMINFO; all zero if the encoder didn't set one.
+    std::array<unsigned char, 16> md5() const;
 
   private:
     AudioSpecs as;
-    std::deque<char> buf;
     struct FlacDecoderImpl;
     std::unique_ptr<FlacDecoderImpl> m_decoder;
 };
@@ -1,4 +1,5 @@
 #include "../flacdecoder.hpp"
+#include "../flac_provider.hpp"
 #include <decoder_test.hpp>
 
 using namespace flac;
@@ -6,3 +7,52 @@ using namespace flac;
 MELOSIC_INIT_LOSSLESS_DECODER_TEST(std::make_unique<FlacDecoder>, "lossless_8_96000_1c.flac");
 MELOSIC_INIT_LOSSLESS_DECODER_TEST(std::make_unique<FlacDecoder>, "lossless_16_96000_1c.flac");
 MELOSIC_INIT_LOSSLESS_DECODER_TEST(std::make_unique<FlacDecoder>, "lossless_24_96000_1c.flac");
+
+TEST_CASE("parallel decode") {
+    const boost::filesystem::path test_data_dir{MELOSIC_TEST_DATA_DIR};
+
+    for(auto filename : {"lossless_8_96000_1c.flac", "lossless_16_96000_1c.flac", "lossless_24_96000_1c.flac"}) {
+        INFO(filename);
+        const auto path = test_data_dir / filename;
+        auto reference_path = path;
+        reference_path.replace_extension(".pcm");
+        boost::filesystem::ifstream reference_file{reference_path};
+        std::vector<char> reference_pcm(boost::filesystem::file_size(reference_path), 0);
+        REQUIRE_NOTHROW(reference_file.read(reference_pcm.data(), reference_pcm.size()));
+
+        FlacDecoder decoder{std::make_unique<boost::filesystem::ifstream>(path)};
+        std::vector<char> decoded_pcm;
+        const auto sink = [&](const char* data, size_t n) { decoded_pcm.insert(decoded_pcm.end(), data, data + n); };
+        std::error_code ec;
+
+        SECTION("sequential") {
+            REQUIRE_NOTHROW(decoder.decode_all(sink, 1, ec));
+        }
+        // small chunks so even these short files are split many ways
+        SECTION("chunked") {
+            REQUIRE_NOTHROW(decoder.decode_all(sink, 4, 4096, ec));
+        }
+        SECTION("one chunk") {
+            REQUIRE_NOTHROW(decoder.decode_all(sink, 4, 1 << 20, ec));
+        }
+        CHECK(!ec);
+        CHECK(decoded_pcm == reference_pcm);
+
+        // left usable afterwards
+        std::vector<char> buf_data(reference_pcm.size() / 2, 0);
+        Melosic::PCMBuffer buf{buf_data.data(), buf_data.size()};
+        REQUIRE_NOTHROW(decoder.seek(0ms));
+        REQUIRE_NOTHROW(CHECK(buf_data.size() == decoder.decode(buf, ec)));
+        CHECK(boost::equal(buf_data, reference_pcm | boost::adaptors::sliced(0, buf_data.size())));
+    }
+}
+
+TEST_CASE("verify by checksum") {
+    const boost::filesystem::path test_data_dir{MELOSIC_TEST_DATA_DIR};
+    provider provider;
+
+    for(auto filename : {"lossless_8_96000_1c.flac", "lossless_16_96000_1c.flac", "lossless_24_96000_1c.flac"}) {
+        INFO(filename);
+        CHECK(provider.verify(std::make_unique<boost::filesystem::ifstream>(test_data_dir / filename)));
+    }
+}
@@ -0,0 +1,41 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <boost/dll/alias.hpp>
+
+#include <melosic/melin/exports.hpp>
+#include <melosic/melin/decoder.hpp>
+using namespace Melosic;
+
+#include "pcmdecoder.hpp"
+#include "pcm_provider.hpp"
+
+namespace pcm {
+
+Plugin::Info pcm_info{"PCM", Plugin::Type::decoder, {1, 0, 0}};
+
+Plugin::Info plugin_info() {
+    return pcm_info;
+}
+MELOSIC_DLL_TYPED_ALIAS(plugin_info)
+
+Decoder::provider* decoder_provider() {
+    return new provider;
+}
+MELOSIC_DLL_TYPED_ALIAS(decoder_provider)
+
+} // namespace pcm
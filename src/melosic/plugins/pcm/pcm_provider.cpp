@@ -0,0 +1,48 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#include <melosic/common/mapped_istream.hpp>
+
+#include "pcmdecoder.hpp"
+#include "pcm_provider.hpp"
+
+namespace pcm {
+
+bool provider::supports_mime(std::string_view mime_type) const {
+    return mime_type == "audio/x-wav" || mime_type == "audio/wav" || mime_type == "audio/vnd.wave" ||
+           mime_type == "audio/x-w64" || mime_type == "audio/x-aiff" || mime_type == "audio/aiff";
+}
+
+std::unique_ptr<Melosic::Decoder::PCMSource> provider::make_decoder(std::unique_ptr<std::istream> in) const {
+    return std::make_unique<pcm_decoder>(std::move(in));
+}
+
+std::unique_ptr<Melosic::Decoder::PCMSource> provider::make_file_decoder(const boost::filesystem::path& path,
+                                                                        std::unique_ptr<std::istream> in) const {
+    // only here, where reading in place pays: a mapped file faults, rather than failing a read, if it's cut short
+    if(auto mapped = Melosic::mapped_istream::open(path))
+        return std::make_unique<pcm_decoder>(std::move(mapped));
+    return make_decoder(std::move(in));
+}
+
+bool provider::verify(std::unique_ptr<std::istream> in) const {
+    // none of these containers carry a checksum; the best there is is all the samples being there
+    return !pcm_decoder{std::move(in)}.truncated();
+}
+
+} // namespace pcm
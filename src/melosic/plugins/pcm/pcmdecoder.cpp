@@ -0,0 +1,387 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <asio/error.hpp>
+
+#include <melosic/common/error.hpp>
+#include <melosic/common/mapped_istream.hpp>
+
+#include "pcmdecoder.hpp"
+
+namespace pcm {
+
+namespace {
+
+uint16_t le16(const char* p) {
+    return uint8_t(p[0]) | uint8_t(p[1]) << 8;
+}
+uint32_t le32(const char* p) {
+    return le16(p) | uint32_t(le16(p + 2)) << 16;
+}
+uint64_t le64(const char* p) {
+    return le32(p) | uint64_t(le32(p + 4)) << 32;
+}
+uint16_t be16(const char* p) {
+    return uint8_t(p[0]) << 8 | uint8_t(p[1]);
+}
+uint32_t be32(const char* p) {
+    return uint32_t(be16(p)) << 16 | be16(p + 2);
+}
+
+// 80 bit IEEE 754 extended precision, big-endian; AIFF's sample rate
+double be_extended(const char* p) {
+    const int exponent = be16(p) & 0x7fff;
+    const auto mantissa = uint64_t(be32(p + 2)) << 32 | be32(p + 6);
+    const auto value = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+    return uint8_t(p[0]) & 0x80 ? -value : value;
+}
+
+bool id_is(const char* p, const char (&id)[5]) {
+    return std::memcmp(p, id, 4) == 0;
+}
+
+// Sony Wave64 chunk ids are GUIDs: a RIFF FOURCC then one of these
+const unsigned char w64_riff_tail[12] = {0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00};
+const unsigned char w64_tail[12] = {0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a};
+
+bool w64_id_is(const char* p, const char (&id)[5], const unsigned char (&tail)[12]) {
+    return id_is(p, id) && std::memcmp(p + 4, tail, sizeof(tail)) == 0;
+}
+
+[[noreturn]] void invalid(const char* why) {
+    BOOST_THROW_EXCEPTION(DecoderInitException() << ErrorTag::Plugin::Info(pcm_info)
+                                                 << ErrorTag::DecodeErrStr(why));
+}
+
+AudioSpecs make_specs(unsigned channels, unsigned bits, double sample_rate) {
+    if(channels == 0 || channels > UINT8_MAX)
+        BOOST_THROW_EXCEPTION(AudioDataUnsupported() << ErrorTag::Plugin::Info(pcm_info)
+                                                     << ErrorTag::Channels(std::min<unsigned>(channels, UINT8_MAX)));
+    if(bits == 0 || bits > 32)
+        BOOST_THROW_EXCEPTION(AudioDataUnsupported() << ErrorTag::Plugin::Info(pcm_info)
+                                                     << ErrorTag::BPS(std::min<unsigned>(bits, UINT8_MAX)));
+    if(!(sample_rate >= 1 && sample_rate <= UINT32_MAX))
+        invalid("invalid sample rate");
+    return AudioSpecs(channels, bits, std::lround(sample_rate));
+}
+
+// where a container keeps its samples and how
+struct container {
+    AudioSpecs as;
+    pcm_decoder::sample_layout layout = pcm_decoder::sample_layout::native;
+    uint64_t data_offset = 0;
+    uint64_t data_size = 0;
+};
+
+// format chunk of RIFF and Wave64
+void parse_fmt(const char* p, uint64_t size, container& c) {
+    if(size < 16)
+        invalid("format chunk too short");
+    auto tag = le16(p);
+    const auto block_align = le16(p + 12);
+    unsigned bits = le16(p + 14);
+    if(tag == 0xfffe) { // WAVE_FORMAT_EXTENSIBLE
+        if(size < 40)
+            invalid("extensible format chunk too short");
+        // sub-format GUID begins with the format tag
+        tag = le16(p + 24);
+        // samples are left-justified in their container; keep their real width where it rounds up to the container's
+        const unsigned valid_bits = le16(p + 18);
+        if(valid_bits > 0 && (valid_bits + 7) / 8 == (bits + 7) / 8)
+            bits = valid_bits;
+    }
+    if(tag != 1) // WAVE_FORMAT_PCM
+        BOOST_THROW_EXCEPTION(AudioDataUnsupported() << ErrorTag::Plugin::Info(pcm_info)
+                                                     << ErrorTag::DecodeErrStr("not integer PCM"));
+
+    c.as = make_specs(le16(p + 2), bits, le32(p + 4));
+    if(c.as.samples_to_bytes(1) != block_align)
+        invalid("block alignment doesn't match sample size");
+    // 8 bit WAV is unsigned
+    if(c.as.bps_in_bytes() == 1)
+        c.layout = pcm_decoder::sample_layout::unsigned_8;
+}
+
+// RIFF/WAVE and RF64/WAVE
+container parse_riff(const char* p, uint64_t size) {
+    const bool rf64 = id_is(p, "RF64");
+    uint64_t ds64_data_size = 0;
+    container c;
+    bool have_fmt = false, have_data = false;
+
+    for(uint64_t pos = 12; pos + 8 <= size && !(have_fmt && have_data);) {
+        const auto body = pos + 8;
+        uint64_t chunk_size = le32(p + pos + 4);
+        if(id_is(p + pos, "ds64")) {
+            if(chunk_size < 24 || chunk_size > size - body)
+                invalid("ds64 chunk too short");
+            ds64_data_size = le64(p + body + 8);
+        } else if(id_is(p + pos, "fmt ")) {
+            if(chunk_size > size - body)
+                invalid("format chunk truncated");
+            parse_fmt(p + body, chunk_size, c);
+            have_fmt = true;
+        } else if(id_is(p + pos, "data")) {
+            if(rf64 && chunk_size == 0xffffffff)
+                chunk_size = ds64_data_size;
+            c.data_offset = body;
+            c.data_size = chunk_size;
+            have_data = true;
+        }
+        // nothing follows a chunk running past the end, eg. data of a recording which didn't know its length
+        if(chunk_size > size - body)
+            break;
+        pos = body + chunk_size + (chunk_size & 1);
+    }
+    if(!have_fmt || !have_data)
+        invalid("missing format or data chunk");
+    return c;
+}
+
+// Sony Wave64: RIFF with GUID ids, 64 bit sizes and 8 byte alignment
+container parse_w64(const char* p, uint64_t size) {
+    container c;
+    bool have_fmt = false, have_data = false;
+
+    for(uint64_t pos = 40; pos + 24 <= size && !(have_fmt && have_data);) {
+        const auto body = pos + 24;
+        // includes the chunk's header
+        const auto chunk_size = le64(p + pos + 16);
+        if(chunk_size < 24)
+            invalid("invalid chunk size");
+        const auto body_size = chunk_size - 24;
+        if(w64_id_is(p + pos, "fmt ", w64_tail)) {
+            if(body_size > size - body)
+                invalid("format chunk truncated");
+            parse_fmt(p + body, body_size, c);
+            have_fmt = true;
+        } else if(w64_id_is(p + pos, "data", w64_tail)) {
+            c.data_offset = body;
+            c.data_size = body_size;
+            have_data = true;
+        }
+        if(body_size > size - body)
+            break;
+        pos = body + body_size + (-body_size & 7);
+    }
+    if(!have_fmt || !have_data)
+        invalid("missing format or data chunk");
+    return c;
+}
+
+// FORM/AIFF and FORM/AIFC
+container parse_aiff(const char* p, uint64_t size) {
+    const bool aifc = id_is(p + 8, "AIFC");
+    container c;
+    uint64_t frames = 0;
+    bool have_comm = false, have_ssnd = false;
+
+    for(uint64_t pos = 12; pos + 8 <= size && !(have_comm && have_ssnd);) {
+        const auto body = pos + 8;
+        const uint64_t chunk_size = be32(p + pos + 4);
+        if(id_is(p + pos, "COMM")) {
+            if(chunk_size < (aifc ? 22u : 18u) || chunk_size > size - body)
+                invalid("COMM chunk too short");
+            c.as = make_specs(be16(p + body), be16(p + body + 6), be_extended(p + body + 8));
+            frames = be32(p + body + 2);
+            // AIFF is big-endian and signed, even 8 bit
+            c.layout = c.as.bps_in_bytes() == 1 ? pcm_decoder::sample_layout::native
+                                                : pcm_decoder::sample_layout::big_endian;
+            if(aifc) {
+                const auto compression = p + body + 18;
+                if(id_is(compression, "sowt"))
+                    c.layout = pcm_decoder::sample_layout::native;
+                else if(!id_is(compression, "NONE") && !id_is(compression, "twos"))
+                    BOOST_THROW_EXCEPTION(AudioDataUnsupported()
+                                          << ErrorTag::Plugin::Info(pcm_info)
+                                          << ErrorTag::DecodeErrStr(std::string(compression, 4) + " compression"));
+            }
+            have_comm = true;
+        } else if(id_is(p + pos, "SSND")) {
+            if(chunk_size < 8 || body + 8 > size)
+                invalid("SSND chunk too short");
+            const uint64_t offset = be32(p + body);
+            if(offset > chunk_size - 8)
+                invalid("SSND offset past its chunk");
+            c.data_offset = body + 8 + offset;
+            c.data_size = chunk_size - 8 - offset;
+            have_ssnd = true;
+        }
+        if(chunk_size > size - body)
+            break;
+        pos = body + chunk_size + (chunk_size & 1);
+    }
+    if(!have_comm || !have_ssnd)
+        invalid("missing COMM or SSND chunk");
+    c.data_size = std::min(c.data_size, c.as.samples_to_bytes(frames));
+    return c;
+}
+
+// stored samples to those decode() gives
+void to_native(pcm_decoder::sample_layout layout, unsigned bytes, const char* in, size_t n, char* out) noexcept {
+    switch(layout) {
+        case pcm_decoder::sample_layout::native:
+            std::memcpy(out, in, n);
+            break;
+        case pcm_decoder::sample_layout::unsigned_8:
+            for(size_t i = 0; i < n; ++i)
+                out[i] = in[i] ^ 0x80;
+            break;
+        case pcm_decoder::sample_layout::big_endian:
+            for(size_t i = 0; i < n; i += bytes)
+                for(unsigned j = 0; j < bytes; ++j)
+                    out[i + j] = in[i + bytes - 1 - j];
+            break;
+    }
+}
+
+} // namespace
+
+pcm_decoder::pcm_decoder(std::unique_ptr<std::istream> input) : m_input(std::move(input)) {
+    assert(m_input != nullptr);
+    read_input();
+
+    const auto p = m_data;
+    const uint64_t size = m_size;
+    container c;
+    if(size >= 12 && (id_is(p, "RIFF") || id_is(p, "RF64")) && id_is(p + 8, "WAVE"))
+        c = parse_riff(p, size);
+    else if(size >= 40 && w64_id_is(p, "riff", w64_riff_tail) && w64_id_is(p + 24, "wave", w64_tail))
+        c = parse_w64(p, size);
+    else if(size >= 12 && id_is(p, "FORM") && (id_is(p + 8, "AIFF") || id_is(p + 8, "AIFC")))
+        c = parse_aiff(p, size);
+    else
+        invalid("unrecognised container");
+
+    if(c.data_offset > size)
+        invalid("data past the end of the file");
+    as = c.as;
+    m_layout = c.layout;
+    m_truncated = c.data_size > size - c.data_offset;
+    m_data += c.data_offset;
+    m_size = as.samples_to_bytes(as.bytes_to_samples(std::min(c.data_size, size - c.data_offset)));
+    m_to_float = sample_converter{sample_format_from_bps(as.bps), sample_format::f32};
+}
+
+pcm_decoder::pcm_decoder(std::unique_ptr<std::istream> input, AudioSpecs specs)
+    : as(make_specs(specs.channels, specs.bps, specs.sample_rate)), m_input(std::move(input)) {
+    assert(m_input != nullptr);
+    read_input();
+    m_size = as.samples_to_bytes(as.bytes_to_samples(m_size));
+    m_to_float = sample_converter{sample_format_from_bps(as.bps), sample_format::f32};
+}
+
+pcm_decoder::~pcm_decoder() {
+}
+
+void pcm_decoder::read_input() {
+    if((m_mapped = dynamic_cast<const mapped_istream*>(m_input.get()))) {
+        m_data = m_mapped->data();
+        m_size = m_mapped->size();
+        return;
+    }
+
+    constexpr size_t block = 1 << 16;
+    while(*m_input) {
+        const auto old_size = m_copy.size();
+        m_copy.resize(old_size + block);
+        m_input->read(m_copy.data() + old_size, block);
+        m_copy.resize(old_size + m_input->gcount());
+    }
+    m_data = m_copy.data();
+    m_size = m_copy.size();
+}
+
+size_t pcm_decoder::decode(PCMBuffer& pcm_buf, std::error_code& ec) {
+    pcm_buf.audio_specs = as;
+    if(m_pos == m_size) {
+        ec = asio::error::eof;
+        return 0;
+    }
+    const auto n = std::min(as.samples_to_bytes(as.bytes_to_samples(asio::buffer_size(pcm_buf))), m_size - m_pos);
+    to_native(m_layout, as.bps_in_bytes(), m_data + m_pos, n, asio::buffer_cast<char*>(pcm_buf));
+    m_pos += n;
+    return n;
+}
+
+size_t pcm_decoder::decode_float(float* out, size_t frames, std::error_code& ec) {
+    if(m_layout != sample_layout::native)
+        return PCMSource::decode_float(out, frames, ec);
+
+    const auto in = view(as.samples_to_bytes(frames), ec);
+    const auto n = as.bytes_to_samples(asio::buffer_size(in));
+    m_to_float.convert(asio::buffer_cast<const void*>(in), n * as.channels, out);
+    return n;
+}
+
+void pcm_decoder::decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads,
+                             std::error_code& ec) {
+    if(m_layout != sample_layout::native) {
+        PCMSource::decode_all(sink, threads, ec);
+        return;
+    }
+    sink(m_data, m_size);
+    m_pos = m_size;
+}
+
+ConstPCMBuffer pcm_decoder::view(size_t max_bytes, std::error_code& ec) {
+    if(m_layout != sample_layout::native)
+        return {};
+    if(m_pos == m_size) {
+        ec = asio::error::eof;
+        return {};
+    }
+    const auto n = std::min(as.samples_to_bytes(as.bytes_to_samples(max_bytes)), m_size - m_pos);
+    ConstPCMBuffer buf{m_data + m_pos, n};
+    buf.audio_specs = as;
+    m_pos += n;
+    return buf;
+}
+
+void pcm_decoder::seek(chrono::milliseconds dur) {
+    m_pos = std::min(as.time_to_bytes(dur), m_size);
+    // page in ahead of the first read from the new position
+    if(m_mapped)
+        m_mapped->will_need(m_data - m_mapped->data() + m_pos, as.time_to_bytes(chrono::seconds{1}));
+}
+
+chrono::milliseconds pcm_decoder::tell() const {
+    return as.bytes_to_time<chrono::milliseconds>(m_pos);
+}
+
+chrono::milliseconds pcm_decoder::duration() const {
+    return as.bytes_to_time<chrono::milliseconds>(m_size);
+}
+
+AudioSpecs pcm_decoder::getAudioSpecs() const {
+    return as;
+}
+
+bool pcm_decoder::valid() const {
+    return m_pos < m_size;
+}
+
+void pcm_decoder::reset() {
+    m_pos = 0;
+}
+
+} // namespace pcm
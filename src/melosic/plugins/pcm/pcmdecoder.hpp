@@ -0,0 +1,100 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#ifndef PCMDECODER_HPP
+#define PCMDECODER_HPP
+
+#include <memory>
+#include <istream>
+#include <vector>
+
+#include <melosic/melin/exports.hpp>
+#include <melosic/melin/decoder.hpp>
+#include <melosic/common/audiospecs.hpp>
+#include <melosic/common/pcmbuffer.hpp>
+#include <melosic/common/sample_convert.hpp>
+
+#include "./exports.hpp"
+
+using namespace Melosic;
+
+namespace Melosic {
+class mapped_istream;
+}
+
+namespace pcm {
+
+extern Plugin::Info pcm_info;
+
+/// Uncompressed integer PCM in WAV (incl. WAVE_FORMAT_EXTENSIBLE), RF64, Sony Wave64, AIFF or AIFF-C, or headerless.
+/// Reads the samples in place from a mapped_istream, otherwise from a copy of the whole stream.
+class PCM_MELIN_API pcm_decoder : public Decoder::PCMSource {
+  public:
+    /// Parses the container's header.
+    explicit pcm_decoder(std::unique_ptr<std::istream> input);
+    /// Headerless interleaved signed little-endian samples.
+    pcm_decoder(std::unique_ptr<std::istream> input, AudioSpecs specs);
+
+    virtual ~pcm_decoder();
+
+    size_t decode(PCMBuffer& pcm_buf, std::error_code& ec) override;
+    size_t decode_float(float* out, size_t frames, std::error_code& ec) override;
+    /// Hands sink the samples in place when they're stored as decode() gives them.
+    void decode_all(const std::function<void(const char*, size_t)>& sink, unsigned threads,
+                    std::error_code& ec) override;
+    /// Empty unless the samples are stored as decode() gives them.
+    ConstPCMBuffer view(size_t max_bytes, std::error_code& ec) override;
+    void seek(chrono::milliseconds dur) override;
+    chrono::milliseconds tell() const override;
+    chrono::milliseconds duration() const override;
+    void reset() override;
+    AudioSpecs getAudioSpecs() const override;
+    bool valid() const override;
+
+    /// Whether the file ends before all the samples its header declares.
+    bool truncated() const noexcept {
+        return m_truncated;
+    }
+
+    // how samples are stored, as opposed to how decode() gives them
+    enum class sample_layout {
+        native,     // signed little-endian, as decode() gives them
+        unsigned_8, // WAV
+        big_endian, // AIFF
+    };
+
+  private:
+    void read_input();
+
+    AudioSpecs as;
+    sample_layout m_layout{sample_layout::native};
+    std::unique_ptr<std::istream> m_input;
+    const mapped_istream* m_mapped{nullptr};
+    // the whole stream when it isn't mapped
+    std::vector<char> m_copy;
+    // the samples, whole frames only
+    const char* m_data{nullptr};
+    size_t m_size{0};
+    size_t m_pos{0};
+    bool m_truncated{false};
+    sample_converter m_to_float;
+};
+
+} // namespace pcm
+
+#endif // PCMDECODER_HPP
@@ -0,0 +1,243 @@
+/**************************************************************************
+**  Copyright (C) 2016 Christian Manning
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#include <algorithm>
+#include <sstream>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <melosic/common/error.hpp>
+#include <melosic/common/mapped_istream.hpp>
+
+#include "../pcmdecoder.hpp"
+#include "../pcm_provider.hpp"
+#include <decoder_test.hpp>
+
+using namespace pcm;
+
+MELOSIC_INIT_LOSSLESS_DECODER_TEST(std::make_unique<pcm_decoder>, "lossless_24_96000_1c.wav");
+
+namespace {
+
+std::string le(uint64_t v, unsigned bytes) {
+    std::string s;
+    for(unsigned i = 0; i < bytes; ++i)
+        s += static_cast<char>(v >> (8 * i));
+    return s;
+}
+
+std::string be(uint64_t v, unsigned bytes) {
+    auto s = le(v, bytes);
+    return {s.rbegin(), s.rend()};
+}
+
+std::string riff_chunk(const std::string& id, const std::string& body) {
+    return id + le(body.size(), 4) + body + (body.size() % 2 ? std::string(1, '\0') : "");
+}
+
+std::string fmt_body(AudioSpecs as, bool extensible) {
+    const auto block_align = as.samples_to_bytes(1);
+    auto body = le(extensible ? 0xfffe : 1, 2) + le(as.channels, 2) + le(as.sample_rate, 4) +
+                le(as.sample_rate * block_align, 4) + le(block_align, 2) + le(as.bps_in_bytes() * 8, 2);
+    if(extensible)
+        body += le(22, 2) + le(as.bps, 2) + le(0x4, 4) + le(1, 2) +
+                "\x00\x00\x00\x00\x10\x00\x80\x00\x00\xaa\x00\x38\x9b\x71"s;
+    return body;
+}
+
+std::string wav(const std::string& data, AudioSpecs as, bool extensible) {
+    const auto chunks = riff_chunk("fmt ", fmt_body(as, extensible)) + riff_chunk("LIST", "INFOabc") +
+                        riff_chunk("data", data);
+    return "RIFF" + le(4 + chunks.size(), 4) + "WAVE" + chunks;
+}
+
+std::string rf64(const std::string& data, AudioSpecs as) {
+    const auto ds64 = riff_chunk("ds64", le(0, 8) + le(data.size(), 8) + le(as.bytes_to_samples(data.size()), 8) +
+                                             le(0, 4));
+    const auto chunks = ds64 + riff_chunk("fmt ", fmt_body(as, false)) + "data" + le(0xffffffff, 4) + data;
+    return "RF64" + le(0xffffffff, 4) + "WAVE" + chunks;
+}
+
+const auto w64_riff_tail = "\x2e\x91\xcf\x11\xa5\xd6\x28\xdb\x04\xc1\x00\x00"s;
+const auto w64_tail = "\xf3\xac\xd3\x11\x8c\xd1\x00\xc0\x4f\x8e\xdb\x8a"s;
+
+std::string w64_chunk(const std::string& id, const std::string& body) {
+    return id + w64_tail + le(24 + body.size(), 8) + body + std::string(-body.size() & 7, '\0');
+}
+
+std::string w64(const std::string& data, AudioSpecs as) {
+    const auto chunks = w64_chunk("fmt ", fmt_body(as, false)) + w64_chunk("junk", "abc") + w64_chunk("data", data);
+    return "riff" + w64_riff_tail + le(40 + chunks.size(), 8) + "wave" + w64_tail + chunks;
+}
+
+std::string aiff(const std::string& data, AudioSpecs as, const std::string& compression) {
+    // 96000 as 80 bit extended: 2^16 * 1.46484375
+    REQUIRE(as.sample_rate == 96000);
+    auto comm = be(as.channels, 2) + be(as.bytes_to_samples(data.size()), 4) + be(as.bps, 2) + be(0x400f, 2) +
+                be(0xbb80000000000000, 8);
+    if(!compression.empty())
+        comm += compression + "\x00\x00"s;
+    const auto ssnd = "SSND" + be(4 + 8 + data.size(), 4) + be(4, 4) + be(0, 4) + "pad!" + data;
+    const auto chunks = "COMM" + be(comm.size(), 4) + comm + ssnd;
+    return "FORM" + be(4 + chunks.size(), 4) + (compression.empty() ? "AIFF" : "AIFC") + chunks;
+}
+
+std::string read_reference(const char* filename) {
+    boost::filesystem::ifstream file{boost::filesystem::path{MELOSIC_TEST_DATA_DIR} / filename};
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+std::string decode_all(pcm_decoder& decoder) {
+    std::string pcm;
+    std::error_code ec;
+    std::vector<char> buf(1000);
+    while(!ec) {
+        PCMBuffer pcm_buf{buf.data(), buf.size()};
+        const auto n = decoder.decode(pcm_buf, ec);
+        pcm.append(buf.data(), n);
+    }
+    CHECK(ec.value() == asio::error::eof);
+    return pcm;
+}
+
+} // namespace
+
+TEST_CASE("containers") {
+    for(auto bps : {8, 16, 24}) {
+        const AudioSpecs as{1, static_cast<uint8_t>(bps), 96000};
+        const auto reference = read_reference(("lossless_" + std::to_string(bps) + "_96000_1c.pcm").c_str());
+        INFO("bps: " << bps);
+
+        // 8 bit WAV is unsigned
+        auto wav_data = reference;
+        if(bps == 8)
+            for(auto& c : wav_data)
+                c ^= 0x80;
+        auto swapped = reference;
+        for(size_t i = 0; i < swapped.size(); i += as.bps_in_bytes())
+            std::reverse(swapped.begin() + i, swapped.begin() + i + as.bps_in_bytes());
+
+        for(auto file : {wav(wav_data, as, false), wav(wav_data, as, true), rf64(wav_data, as), w64(wav_data, as),
+                         aiff(swapped, as, ""), aiff(swapped, as, "NONE"), aiff(reference, as, "sowt")}) {
+            INFO(file.substr(0, 4));
+            pcm_decoder decoder{std::make_unique<std::istringstream>(file)};
+            REQUIRE(decoder.getAudioSpecs() == as);
+            CHECK(decoder.duration() == 1000ms);
+            CHECK(!decoder.truncated());
+            CHECK(decode_all(decoder) == reference);
+
+            decoder.seek(500ms);
+            CHECK(decoder.tell() == 500ms);
+            CHECK(decode_all(decoder) == reference.substr(reference.size() / 2));
+        }
+    }
+}
+
+TEST_CASE("mapped") {
+    const boost::filesystem::path path{MELOSIC_TEST_DATA_DIR "/lossless_24_96000_1c.wav"};
+    const auto reference = read_reference("lossless_24_96000_1c.pcm");
+    auto input = mapped_istream::open(path);
+    REQUIRE(input);
+    const auto mapping = input->data();
+    pcm_decoder decoder{std::move(input)};
+    std::error_code ec;
+
+    SECTION("view") {
+        const auto view = decoder.view(reference.size() / 2, ec);
+        CHECK(!ec);
+        REQUIRE(asio::buffer_size(view) == reference.size() / 2);
+        // the samples in place
+        CHECK(asio::buffer_cast<const char*>(view) == mapping + 44);
+        CHECK(std::equal(reference.begin(), reference.begin() + reference.size() / 2,
+                         asio::buffer_cast<const char*>(view)));
+        CHECK(decoder.tell() == 500ms);
+        CHECK(asio::buffer_size(decoder.view(reference.size(), ec)) == reference.size() / 2);
+        CHECK(asio::buffer_size(decoder.view(reference.size(), ec)) == 0);
+        CHECK(ec.value() == asio::error::eof);
+    }
+    SECTION("decode all") {
+        std::string pcm;
+        decoder.decode_all([&](const char* data, size_t n) { pcm.append(data, n); }, 1, ec);
+        CHECK(!ec);
+        CHECK(pcm == reference);
+    }
+    SECTION("float") {
+        std::vector<float> out(1000);
+        CHECK(decoder.decode_float(out.data(), out.size(), ec) == out.size());
+        CHECK(!ec);
+        std::vector<float> expected(out.size());
+        sample_converter{sample_format::s24_3, sample_format::f32}.convert(reference.data(), out.size(),
+                                                                          expected.data());
+        CHECK(out == expected);
+    }
+}
+
+TEST_CASE("provider maps files") {
+    provider provider;
+    // nothing in the stream given; read from the mapped file
+    auto decoder = provider.make_file_decoder(MELOSIC_TEST_DATA_DIR "/lossless_24_96000_1c.wav",
+                                              std::make_unique<std::istringstream>());
+    std::error_code ec;
+    CHECK(asio::buffer_size(decoder->view(3000, ec)) == 3000);
+    CHECK(!ec);
+}
+
+TEST_CASE("not in place") {
+    const auto reference = read_reference("lossless_8_96000_1c.pcm");
+    auto data = reference;
+    for(auto& c : data)
+        c ^= 0x80;
+    pcm_decoder decoder{std::make_unique<std::istringstream>(wav(data, {1, 8, 96000}, false))};
+    std::error_code ec;
+    CHECK(asio::buffer_size(decoder.view(reference.size(), ec)) == 0);
+    CHECK(!ec);
+    CHECK(decoder.tell() == 0ms);
+    CHECK(decode_all(decoder) == reference);
+}
+
+TEST_CASE("headerless") {
+    const auto reference = read_reference("lossless_16_96000_1c.pcm");
+    pcm_decoder decoder{std::make_unique<std::istringstream>(reference), {1, 16, 96000}};
+    CHECK(decoder.duration() == 1000ms);
+    CHECK(decode_all(decoder) == reference);
+}
+
+TEST_CASE("truncated") {
+    const auto reference = read_reference("lossless_16_96000_1c.pcm");
+    auto file = wav(reference, {1, 16, 96000}, false);
+    // an odd byte short, leaving part of the last sample
+    file.resize(file.size() - 1001);
+    provider provider;
+    CHECK(!provider.verify(std::make_unique<std::istringstream>(file)));
+
+    pcm_decoder decoder{std::make_unique<std::istringstream>(file)};
+    CHECK(decoder.truncated());
+    CHECK(decode_all(decoder) == reference.substr(0, reference.size() - 1002));
+
+    CHECK(provider.verify(std::make_unique<std::istringstream>(wav(reference, {1, 16, 96000}, false))));
+}
+
+TEST_CASE("unsupported") {
+    CHECK_THROWS_AS(pcm_decoder{std::make_unique<std::istringstream>("fLaC not a wav file at all")},
+                    DecoderInitException);
+    auto float_wav = wav(std::string(400, '\0'), {1, 32, 96000}, false);
+    float_wav[20] = 3; // WAVE_FORMAT_IEEE_FLOAT
+    CHECK_THROWS_AS(pcm_decoder{std::make_unique<std::istringstream>(float_wav)}, AudioDataUnsupported);
+}
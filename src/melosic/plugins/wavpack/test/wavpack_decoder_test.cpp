@@ -1,3 +1,5 @@
+#include <chrono>
+
 #include "../wavpackdecoder.hpp"
 #include "../wavpack_provider.hpp"
 #include <decoder_test.hpp>
@@ -54,3 +56,34 @@ TEST_CASE("verify by checksums") {
         CHECK(provider.verify(std::make_unique<boost::filesystem::ifstream>(path)));
     }
 }
+
+// not run by default; eg. wavpack_decoder_test "[throughput]"
+TEST_CASE("decode throughput", "[.][throughput]") {
+    const boost::filesystem::path test_data_dir{MELOSIC_TEST_DATA_DIR};
+    using clock = std::chrono::steady_clock;
+
+    for(auto filename : {"lossless_8_96000_1c.wv", "lossless_16_96000_1c.wv", "lossless_24_96000_1c.wv",
+                         "lossless_32_96000_1c.wv"}) {
+        const auto path = test_data_dir / filename;
+        REQUIRE(boost::filesystem::exists(path));
+
+        // player sized chunks, so per-call overhead shows
+        std::vector<char> chunk(8192);
+        Melosic::PCMBuffer buf{chunk.data(), chunk.size()};
+        std::size_t bytes = 0;
+        clock::duration elapsed{};
+        for(int pass = 0; pass < 20; ++pass) {
+            wavpack_decoder decoder{std::make_unique<boost::filesystem::ifstream>(path)};
+            std::error_code ec;
+            const auto start = clock::now();
+            while(!ec)
+                bytes += decoder.decode(buf, ec);
+            elapsed += clock::now() - start;
+            CHECK(ec.value() == asio::error::eof);
+        }
+
+        const auto secs = std::chrono::duration<double>(elapsed).count();
+        WARN(filename << ": " << bytes / secs / (1 << 20) << " MiB/s");
+        CHECK(bytes > 0);
+    }
+}
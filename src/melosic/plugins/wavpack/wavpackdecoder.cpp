@@ -16,7 +16,6 @@
 **************************************************************************/
 
 #include <iostream>
-#include <experimental/dynarray>
 
 #include <boost/integer.hpp>
 #include <boost/iostreams/read.hpp>
@@ -30,6 +29,7 @@ namespace io = boost::iostreams;
 #include <melosic/common/pcmbuffer.hpp>
 #include <melosic/common/error.hpp>
 #include <melosic/common/pcm_sample.hpp>
+#include <melosic/common/sample_convert.hpp>
 #include <melosic/melin/exports.hpp>
 using namespace Melosic;
 
@@ -97,6 +97,12 @@ int can_seek_impl(void* input) {
     return true;
 }
 
+// 8 bit PCM is unsigned
+void pack_u8(const int32_t* in, std::size_t n, void* out) noexcept {
+    for(std::size_t i = 0; i < n; ++i)
+        static_cast<char*>(out)[i] = static_cast<char>(in[i] + 0x80);
+}
+
 wavpack_decoder::wavpack_decoder(std::unique_ptr<std::istream> input)
     : m_input(std::move(input)), m_stream_reader({.read_bytes = read_bytes_impl,
                                                   .get_pos = get_pos_impl,
@@ -117,6 +123,25 @@ wavpack_decoder::wavpack_decoder(std::unique_ptr<std::istream> input)
     as.bps = WavpackGetBitsPerSample(m_wavpack.get());
     as.sample_rate = WavpackGetSampleRate(m_wavpack.get());
     as.channels = WavpackGetNumChannels(m_wavpack.get());
+
+    // unpacked samples span the full width of their container, eg. 12 bit audio is scaled to 16
+    switch(as.bps_in_bytes()) {
+        case 1:
+            m_pack = &pack_u8;
+            break;
+        case 2:
+            m_pack = &pack<16>;
+            break;
+        case 3:
+            m_pack = &pack<24>;
+            break;
+        case 4:
+            m_pack = &pack<32>;
+            break;
+        default:
+            BOOST_THROW_EXCEPTION(AudioDataUnsupported() << ErrorTag::Plugin::Info(wavpack_info)
+                                                         << ErrorTag::BPS(as.bps));
+    }
 }
 
 wavpack_decoder::~wavpack_decoder() {
@@ -140,16 +165,13 @@ AudioSpecs wavpack_decoder::getAudioSpecs() const {
 
 size_t wavpack_decoder::decode(PCMBuffer& pcm_buf, std::error_code& ec) {
     pcm_buf.audio_specs = as;
-    const auto bytes_requested = asio::buffer_size(pcm_buf);
-    const auto samples_requested = as.bytes_to_samples(bytes_requested);
-
-    std::experimental::dynarray<int32_t> buf(samples_requested, 0);
-
     // a wavpack "sample" is 1 sample per channel
-    const auto samples_returned = WavpackUnpackSamples(m_wavpack.get(), buf.data(), samples_requested / as.channels) * as.channels;
-    const auto bytes_returned = as.samples_to_bytes(samples_returned);
+    const auto frames = as.bytes_to_samples(asio::buffer_size(pcm_buf));
+    if(m_unpack_buf.size() < frames * as.channels)
+        m_unpack_buf.resize(frames * as.channels);
 
-    if(samples_returned != samples_requested) {
+    const auto frames_returned = WavpackUnpackSamples(m_wavpack.get(), m_unpack_buf.data(), frames);
+    if(frames_returned != frames) {
         ec = asio::error::eof;
         if(WavpackGetNumErrors(m_wavpack.get()) > 0) {
             BOOST_THROW_EXCEPTION(DecoderException()
@@ -158,30 +180,27 @@ size_t wavpack_decoder::decode(PCMBuffer& pcm_buf, std::error_code& ec) {
         }
     }
 
-    assert(bytes_requested >= as.bps_in_bytes() * samples_returned);
-    for(auto i = 0u; i < samples_returned; i++) {
-        switch(as.bps) {
-            case 8:
-                asio::buffer_cast<pcm_sample<8>*>(pcm_buf)[i] = buf[i] + 0x80;
-                break;
-            case 12:
-            case 16:
-                asio::buffer_cast<pcm_sample<16>*>(pcm_buf)[i] = buf[i];
-                break;
-            case 20:
-            case 24:
-                asio::buffer_cast<pcm_sample<24>*>(pcm_buf)[i] = buf[i];
-                break;
-            case 32:
-                asio::buffer_cast<pcm_sample<32>*>(pcm_buf)[i] = buf[i];
-                break;
-            default:
-                BOOST_THROW_EXCEPTION(DecoderException()
-                                      << ErrorTag::Plugin::Info(wavpack_info)
-                                      << ErrorTag::DecodeErrStr("Unsupported number of bits per sample"));
+    m_pack(m_unpack_buf.data(), frames_returned * as.channels, asio::buffer_cast<void*>(pcm_buf));
+    return as.samples_to_bytes(frames_returned);
+}
+
+size_t wavpack_decoder::decode_float(float* out, size_t frames, std::error_code& ec) {
+    if(m_unpack_buf.size() < frames * as.channels)
+        m_unpack_buf.resize(frames * as.channels);
+
+    const auto frames_returned = WavpackUnpackSamples(m_wavpack.get(), m_unpack_buf.data(), frames);
+    if(frames_returned != frames) {
+        ec = asio::error::eof;
+        if(WavpackGetNumErrors(m_wavpack.get()) > 0) {
+            BOOST_THROW_EXCEPTION(DecoderException()
+                                  << ErrorTag::Plugin::Info(wavpack_info)
+                                  << ErrorTag::DecodeErrStr(WavpackGetErrorMessage(m_wavpack.get())));
         }
     }
-    return bytes_returned / as.channels;
+
+    // unpacked samples span the full width of their container, eg. 12 bit audio is scaled to 16
+    int_to_float(m_unpack_buf.data(), frames_returned * as.channels, as.bps_in_bytes() * 8, out);
+    return frames_returned;
 }
 
 bool wavpack_decoder::valid() const {
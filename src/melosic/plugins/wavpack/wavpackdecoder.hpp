@@ -42,6 +42,7 @@ struct WAVPACK_MELIN_API wavpack_decoder : Decoder::PCMSource {
     chrono::milliseconds duration() const;
     AudioSpecs getAudioSpecs() const;
     size_t decode(PCMBuffer& buf, std::error_code& ec);
+    size_t decode_float(float* out, size_t frames, std::error_code& ec) override;
     bool valid() const;
     void reset();
 
@@ -53,6 +54,10 @@ struct WAVPACK_MELIN_API wavpack_decoder : Decoder::PCMSource {
 
     AudioSpecs as;
     std::vector<char> buf;
+    // WavpackUnpackSamples output; only grows
+    std::vector<int32_t> m_unpack_buf;
+    // packs m_unpack_buf into decode()'s buffer; chosen for the stream's width
+    void (*m_pack)(const int32_t* in, std::size_t n, void* out) noexcept {nullptr};
     std::unique_ptr<std::istream> m_input;
     ::WavpackStreamReader m_stream_reader;
     std::unique_ptr<::WavpackContext, WavpackDestroyer> m_wavpack;